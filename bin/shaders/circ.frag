@@ -15,6 +15,7 @@ in vec4 epos;
 in vec3 norm;
 in vec2 tc;	// used for texture coordinate visualization
 in vec4 wpos;
+flat in int tex_idx;	// texture index of the sphere, -1 for walls
 
 // output of the fragment shader
 out vec4 fragColor;
@@ -43,7 +44,6 @@ uniform sampler2D	TEX5;
 uniform sampler2D	TEX6;
 uniform sampler2D	TEX7;
 uniform sampler2D	TEX8;
-uniform int			tex_idx;
 
 uniform vec4 spheres[9]; // {x, y, z, r}
 
@@ -2,6 +2,8 @@
 layout(location=0) in vec3 position;
 layout(location=1) in vec3 normal;
 layout(location=2) in vec2 texcoord;
+layout(location=3) in vec4 center_radius;	// per instance: xyz center, w radius
+layout(location=5) in int instance_tex;		// per instance: texture index
 
 // outputs of vertex shader = input to fragment shader
 // out vec4 gl_Position: a built-in output variable that should be written in main()
@@ -9,19 +11,40 @@ out vec4 epos;	// eye-space position
 out vec3 norm;	// the second output: not used yet
 out vec2 tc;	// the third output: not used yet
 out vec4 wpos;
+flat out int tex_idx;	// texture index of the sphere, -1 for walls
 
 // uniform variables
 uniform mat4	model_matrix;	// 4x4 transformation matrix: explained later in the lecture
 uniform mat4	view_matrix;	// tricky 4x4 aspect-correction matrix
 uniform mat4	projection_matrix;
+uniform bool	b_instanced;	// spheres: model transform from the instance attributes
+uniform vec4	orientation;	// spheres: unit quaternion (x,y,z,w), the same for every instance
+
+// rotation of v by the unit quaternion q
+vec3 rotate( vec4 q, vec3 v )
+{
+	return v + 2.0*cross(q.xyz, cross(q.xyz, v) + q.w*v);
+}
 
 void main()
 {
-	wpos = model_matrix * vec4(position,1);
+	vec3 n;
+	if( b_instanced )
+	{
+		wpos = vec4(rotate(orientation, position)*center_radius.w + center_radius.xyz, 1);
+		n = rotate(orientation, normal);
+		tex_idx = instance_tex;
+	}
+	else
+	{
+		wpos = model_matrix * vec4(position,1);
+		n = mat3(model_matrix)*normal;
+		tex_idx = -1;
+	}
 	epos = view_matrix * wpos;
 	gl_Position = projection_matrix * epos;
 
 	// other outputs to rasterizer/fragment shader
-	norm = normalize(mat3(view_matrix*model_matrix)*normal);
+	norm = normalize(mat3(view_matrix)*n);
 	tc = texcoord;
 }
\ No newline at end of file
@@ -0,0 +1,369 @@
+#pragma once
+#ifndef __AABBTREE_H__
+#define __AABBTREE_H__
+
+#include <cfloat>
+#include <vector>
+
+/*
+* Dynamic AABB tree broadphase
+* - one leaf per sphere holding a "fat" box enlarged by AABB_FAT_RATIO * radius
+*   plus the distance the sphere travels in the lookahead time
+* - a leaf is reinserted only when the tight box of its sphere leaves the fat box
+* - insertion picks the sibling by surface area, tree rotations keep it balanced
+* - suits mixed radii (10~80, or PLANET_RATIO 0.382~109.2) where one grid cell size fits badly
+*/
+static const float AABB_FAT_RATIO = 0.25f;	// fat margin relative to the radius
+static const float AABB_LOOKAHEAD_STEPS = 1.0f;	// steps of motion covered by the fat margin
+static const int AABB_NULL = -1;
+
+struct aabb_t
+{
+	vec3	lo = vec3(0);
+	vec3	hi = vec3(0);
+
+	bool	contains( const aabb_t& b ) const { return lo.x <= b.lo.x && lo.y <= b.lo.y && lo.z <= b.lo.z && b.hi.x <= hi.x && b.hi.y <= hi.y && b.hi.z <= hi.z; }
+	bool	overlaps( const aabb_t& b ) const { return lo.x <= b.hi.x && b.lo.x <= hi.x && lo.y <= b.hi.y && b.lo.y <= hi.y && lo.z <= b.hi.z && b.lo.z <= hi.z; }
+	float	area() const { vec3 d = hi - lo; return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x); }
+};
+
+inline aabb_t aabb_union(const aabb_t& a, const aabb_t& b)
+{
+	aabb_t u;
+	u.lo = vec3(std::min(a.lo.x, b.lo.x), std::min(a.lo.y, b.lo.y), std::min(a.lo.z, b.lo.z));
+	u.hi = vec3(std::max(a.hi.x, b.hi.x), std::max(a.hi.y, b.hi.y), std::max(a.hi.z, b.hi.z));
+	return u;
+}
+
+inline aabb_t sphere_aabb(const vec3& center, float radius, float margin = 0.0f)
+{
+	float r = radius + margin;
+	return aabb_t{ center - vec3(r), center + vec3(r) };
+}
+
+struct aabb_node_t
+{
+	aabb_t	box;
+	int		parent = AABB_NULL;		// also the next free node when released
+	int		left = AABB_NULL;
+	int		right = AABB_NULL;
+	int		height = 0;				// leaf: 0, free: -1
+	uint	body = 0;				// sphere index of a leaf
+
+	bool	is_leaf() const { return left == AABB_NULL; }
+};
+
+struct aabb_tree_t
+{
+	std::vector<aabb_node_t>	nodes;
+	int							root = AABB_NULL;
+	int							free_list = AABB_NULL;
+	std::vector<int>			leaf_of;	// sphere index -> leaf node
+	mutable std::vector<int>	stack;		// traversal stack of queries
+	mutable std::vector<std::pair<int, int>>	pair_stack;	// traversal stack of self-overlap
+
+	// public functions
+	void	clear();
+	void	update( const body_store_t& bodies, float lookahead = 0.0f );
+	float	fat_margin( const body_store_t& bodies, uint i, float lookahead ) const;
+	void	find_pairs( const body_store_t& bodies, std::vector<pair_t>& pairs ) const;
+	int		ray_cast( const body_store_t& bodies, vec3 origin, vec3 dir, float* hit_t = nullptr ) const;
+	template <typename F>
+	void	query( const aabb_t& box, F callback ) const;	// callback(uint body) per overlapping fat leaf
+
+	// internal functions
+	int		alloc_node();
+	void	free_node( int i );
+	void	insert_leaf( int leaf );
+	void	remove_leaf( int leaf );
+	int		balance( int a );
+	void	refit( int i );
+};
+
+inline void aabb_tree_t::clear()
+{
+	nodes.clear();
+	leaf_of.clear();
+	root = free_list = AABB_NULL;
+}
+
+inline int aabb_tree_t::alloc_node()
+{
+	if (free_list == AABB_NULL)
+	{
+		nodes.emplace_back();
+		return int(nodes.size()) - 1;
+	}
+	int i = free_list;
+	free_list = nodes[i].parent;
+	nodes[i] = aabb_node_t();
+	return i;
+}
+
+inline void aabb_tree_t::free_node(int i)
+{
+	nodes[i].parent = free_list;
+	nodes[i].height = -1;
+	free_list = i;
+}
+
+inline void aabb_tree_t::refit(int i)
+{
+	aabb_node_t& n = nodes[i];
+	n.box = aabb_union(nodes[n.left].box, nodes[n.right].box);
+	n.height = 1 + std::max(nodes[n.left].height, nodes[n.right].height);
+}
+
+inline float aabb_tree_t::fat_margin(const body_store_t& bodies, uint i, float lookahead) const
+{
+	return AABB_FAT_RATIO * float(bodies.radius[i]) + length(bodies.velocity(i)) * lookahead;
+}
+
+inline void aabb_tree_t::update(const body_store_t& bodies, float lookahead)
+{
+	// rebuild when spheres are added or removed
+	if (leaf_of.size() != bodies.size())
+	{
+		clear();
+		leaf_of.resize(bodies.size());
+		for (uint i = 0; i < uint(bodies.size()); i++)
+		{
+			int leaf = alloc_node();
+			nodes[leaf].body = i;
+			nodes[leaf].box = sphere_aabb(bodies.center(i), float(bodies.radius[i]), fat_margin(bodies, i, lookahead));
+			leaf_of[i] = leaf;
+			insert_leaf(leaf);
+		}
+		return;
+	}
+
+	// reinsert only the spheres that left their fat box
+	for (uint i = 0; i < uint(bodies.size()); i++)
+	{
+		vec3 c = bodies.center(i);
+		float r = float(bodies.radius[i]);
+		int leaf = leaf_of[i];
+		if (nodes[leaf].box.contains(sphere_aabb(c, r))) continue;
+
+		remove_leaf(leaf);
+		nodes[leaf].box = sphere_aabb(c, r, fat_margin(bodies, i, lookahead));
+		insert_leaf(leaf);
+	}
+}
+
+inline void aabb_tree_t::insert_leaf(int leaf)
+{
+	if (root == AABB_NULL)
+	{
+		root = leaf;
+		nodes[leaf].parent = AABB_NULL;
+		return;
+	}
+
+	// find the best sibling by the surface area heuristic
+	aabb_t leaf_box = nodes[leaf].box;
+	int index = root;
+	while (!nodes[index].is_leaf())
+	{
+		const aabb_node_t& n = nodes[index];
+		float area = n.box.area();
+		float combined = aabb_union(n.box, leaf_box).area();
+		float cost = 2.0f * combined;				// pair with this node
+		float inherited = 2.0f * (combined - area);	// cost pushed down to children
+
+		auto descend_cost = [&](int c)
+		{
+			float a = aabb_union(leaf_box, nodes[c].box).area();
+			return (nodes[c].is_leaf() ? a : a - nodes[c].box.area()) + inherited;
+		};
+		float cost_left = descend_cost(n.left);
+		float cost_right = descend_cost(n.right);
+
+		if (cost < cost_left && cost < cost_right) break;
+		index = cost_left < cost_right ? n.left : n.right;
+	}
+
+	// splice a new parent between the sibling and its old parent
+	int sibling = index;
+	int old_parent = nodes[sibling].parent;
+	int new_parent = alloc_node();
+	nodes[new_parent].parent = old_parent;
+	nodes[new_parent].left = sibling;
+	nodes[new_parent].right = leaf;
+	nodes[sibling].parent = new_parent;
+	nodes[leaf].parent = new_parent;
+	refit(new_parent);
+
+	if (old_parent == AABB_NULL) root = new_parent;
+	else if (nodes[old_parent].left == sibling) nodes[old_parent].left = new_parent;
+	else nodes[old_parent].right = new_parent;
+
+	// walk back up, rebalancing and refitting
+	for (int i = nodes[leaf].parent; i != AABB_NULL; i = nodes[i].parent)
+	{
+		i = balance(i);
+		refit(i);
+	}
+}
+
+inline void aabb_tree_t::remove_leaf(int leaf)
+{
+	if (leaf == root) { root = AABB_NULL; return; }
+
+	int parent = nodes[leaf].parent;
+	int grand_parent = nodes[parent].parent;
+	int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+	nodes[sibling].parent = grand_parent;
+	free_node(parent);
+	if (grand_parent == AABB_NULL) { root = sibling; return; }
+
+	if (nodes[grand_parent].left == parent) nodes[grand_parent].left = sibling;
+	else nodes[grand_parent].right = sibling;
+
+	for (int i = grand_parent; i != AABB_NULL; i = nodes[i].parent)
+	{
+		i = balance(i);
+		refit(i);
+	}
+}
+
+// rotate the taller grandchild up when the children heights differ by more than one
+inline int aabb_tree_t::balance(int a)
+{
+	if (nodes[a].is_leaf() || nodes[a].height < 2) return a;
+
+	int b = nodes[a].left, c = nodes[a].right;
+	int diff = nodes[c].height - nodes[b].height;
+	if (diff >= -1 && diff <= 1) return a;
+
+	// p: child to promote, q: its sibling which stays under a
+	bool right_heavy = diff > 1;
+	int p = right_heavy ? c : b;
+	int f = nodes[p].left, g = nodes[p].right;
+
+	// p takes the place of a
+	nodes[p].left = a;
+	nodes[p].parent = nodes[a].parent;
+	nodes[a].parent = p;
+	if (nodes[p].parent == AABB_NULL) root = p;
+	else if (nodes[nodes[p].parent].left == a) nodes[nodes[p].parent].left = p;
+	else nodes[nodes[p].parent].right = p;
+
+	// the taller grandchild stays with p, the shorter one moves under a
+	int keep = nodes[f].height > nodes[g].height ? f : g;
+	int move = keep == f ? g : f;
+	nodes[p].right = keep;
+	if (right_heavy) nodes[a].right = move;
+	else nodes[a].left = move;
+	nodes[move].parent = a;
+
+	refit(a);
+	refit(p);
+	return p;
+}
+
+template <typename F>
+inline void aabb_tree_t::query(const aabb_t& box, F callback) const
+{
+	if (root == AABB_NULL) return;
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		const aabb_node_t& n = nodes[stack.back()];
+		stack.pop_back();
+		if (!n.box.overlaps(box)) continue;
+		if (n.is_leaf()) callback(n.body);
+		else { stack.push_back(n.left); stack.push_back(n.right); }
+	}
+}
+
+// self-overlap by descending the tree against itself, so every pair of subtrees is visited once
+inline void aabb_tree_t::find_pairs(const body_store_t& bodies, std::vector<pair_t>& pairs) const
+{
+	pairs.clear();
+	if (root == AABB_NULL) return;
+
+	pair_stack.clear();
+	pair_stack.emplace_back(root, root);
+	while (!pair_stack.empty())
+	{
+		auto [a, b] = pair_stack.back();
+		pair_stack.pop_back();
+		const aabb_node_t& na = nodes[a];
+		const aabb_node_t& nb = nodes[b];
+
+		if (a == b)
+		{	// pairs within one subtree
+			if (na.is_leaf()) continue;
+			pair_stack.emplace_back(na.left, na.left);
+			pair_stack.emplace_back(na.right, na.right);
+			pair_stack.emplace_back(na.left, na.right);
+			continue;
+		}
+
+		if (!na.box.overlaps(nb.box)) continue;
+		if (na.is_leaf() && nb.is_leaf())
+		{
+			uint i = std::min(na.body, nb.body), j = std::max(na.body, nb.body);
+			if (aabb_overlap(bodies, i, j)) pairs.push_back(pair_t{ i, j });
+		}
+		else if (nb.is_leaf() || (!na.is_leaf() && na.height >= nb.height))
+		{
+			pair_stack.emplace_back(na.left, b);
+			pair_stack.emplace_back(na.right, b);
+		}
+		else
+		{
+			pair_stack.emplace_back(a, nb.left);
+			pair_stack.emplace_back(a, nb.right);
+		}
+	}
+}
+
+// returns the index of the nearest sphere hit by the ray, or -1
+inline int aabb_tree_t::ray_cast(const body_store_t& bodies, vec3 origin, vec3 dir, float* hit_t) const
+{
+	int hit = -1;
+	float best = FLT_MAX;
+	if (root == AABB_NULL) return hit;
+
+	vec3 inv = vec3(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		const aabb_node_t& n = nodes[stack.back()];
+		stack.pop_back();
+
+		// slab test against the node box
+		float t0 = 0.0f, t1 = best;
+		for (int a = 0; a < 3; a++)
+		{
+			float o = (&origin.x)[a], d = (&inv.x)[a];
+			float ta = ((&n.box.lo.x)[a] - o) * d, tb = ((&n.box.hi.x)[a] - o) * d;
+			if (ta > tb) std::swap(ta, tb);
+			t0 = std::max(t0, ta);
+			t1 = std::min(t1, tb);
+		}
+		if (t0 > t1) continue;
+
+		if (!n.is_leaf()) { stack.push_back(n.left); stack.push_back(n.right); continue; }
+
+		// exact ray-sphere test on leaves
+		float r = float(bodies.radius[n.body]);
+		vec3 oc = origin - bodies.center(n.body);
+		float a = dot(dir, dir), b = dot(oc, dir), c = dot(oc, oc) - r * r;
+		float disc = b * b - a * c;
+		if (disc < 0) continue;
+		float t = (-b - sqrtf(disc)) / a;
+		if (t < 0) t = (-b + sqrtf(disc)) / a;
+		if (t >= 0 && t < best) { best = t; hit = int(n.body); }
+	}
+
+	if (hit_t) *hit_t = best;
+	return hit;
+}
+
+#endif
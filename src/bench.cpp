@@ -0,0 +1,528 @@
+#include "fpmode.h"		// no fma contraction, before any code
+#include "cgmath.h"		// slee's simple math library
+#include "wall.h"		// wall class definition
+#include "random.h"		// seeded random number generator
+#include "sphere.h"		// sphere class definition
+#include "body.h"		// structure-of-arrays body store
+#include "spawn.h"		// non-overlapping sphere spawner
+#include "simd.h"		// SSE/AVX2/AVX-512 wrapper
+#include "narrowphase.h"	// batched narrowphase and impulse
+#include "container.h"	// convex container walls
+#include "grid.h"		// uniform grid broadphase
+#include "sap.h"		// sweep-and-prune broadphase
+#include "aabbtree.h"	// dynamic AABB tree broadphase
+#include "paircache.h"	// persistent contact-pair cache
+#include "parallel.h"	// worker threads
+#include "solver.h"		// parallel contact solver
+#include "ccd.h"		// continuous collision detection
+#include "event.h"		// event-driven hard-sphere engine
+#include "octree.h"		// Morton-ordered octree
+#include "gravity.h"	// Barnes-Hut gravity
+#include "integrator.h"	// integrator policies
+#include "trajectory.h"	// compressed trajectory recorder
+#include "physics.h"	// per-step simulation driver
+#include "stepper.h"	// fixed-timestep accumulator
+#include <atomic>
+#include <cstddef>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+//*************************************
+// physics benchmark suite
+// - narrowphase: SIMD against the scalar path (one sphere against a run)
+// - spawn: spawn_spheres() for both modes
+// - walls: bounce_walls() on one thread
+// - elastic: resolve_contacts() and solve_contacts_parallel() on the grid broadphase pairs
+// - step: physics_t::step() with the viewer's defaults, without and with the pair cache (steps
+//   that reused it, time saved), and with ccd (cost per simulated second against the default)
+// - integrator: each gravity integrator policy over ORBIT_TIME of orbits around the sun at
+//   several steps; ns per body (per step) and the largest relative energy error of the flow
+// - sphere counts 10 ~ 10^6 at several packing fractions (sphere volume / box volume);
+//   ns per body (per step), pairs tested vs colliding and heap allocations per call
+//   are printed and written as JSON (--json FILE) to compare versions
+
+static const int REPEAT = 20;						// narrowphase repeats
+static const double BODY_BUDGET = 2e7;				// body updates per timed case
+static const uint WARMUP_STEPS = 2;					// steps before the timed ones (first-step allocations)
+static const uint SETTLE_STEPS = 10;				// steps from the spawned (contact-free) state to the measured one
+static const uint ORBIT_BODIES = 64;				// integrator: bodies around the sun
+static const float ORBIT_TIME = 30.0f;				// integrator: simulated seconds (about two orbits at the inner radius)
+static const float ORBIT_DT[] = { 1 / 240.0f, 1 / 60.0f, 1 / 15.0f, 1 / 4.0f };	// integrator steps
+static const float DEFAULT_FRACTION = 0.1f;
+static const uint COUNTS[] = { 10, 100, 1000, 10000, 100000, 1000000 };
+static const float FRACTIONS[] = { 0.01f, 0.05f, 0.1f, 0.2f, 0.3f };
+
+//*************************************
+// heap allocation counter: every operator new of the process goes through here
+static std::atomic<size_t> alloc_count(0), alloc_bytes(0);
+
+static void* counted_alloc(size_t n, size_t align)
+{
+	alloc_count++;
+	alloc_bytes += n;
+#ifdef _WIN32
+	void* p = align > alignof(std::max_align_t) ? _aligned_malloc(n ? n : 1, align) : malloc(n ? n : 1);
+#else
+	void* p = align > alignof(std::max_align_t) ? aligned_alloc(align, (n + align - 1) / align * align) : malloc(n ? n : 1);
+#endif
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+
+static void counted_free(void* p, size_t align)
+{
+#ifdef _WIN32
+	if (align > alignof(std::max_align_t)) { _aligned_free(p); return; }
+#else
+	(void) align;
+#endif
+	free(p);
+}
+
+void* operator new(size_t n) { return counted_alloc(n, 0); }
+void* operator new(size_t n, std::align_val_t a) { return counted_alloc(n, size_t(a)); }
+void operator delete(void* p) noexcept { counted_free(p, 0); }
+void operator delete(void* p, size_t) noexcept { counted_free(p, 0); }
+void operator delete(void* p, std::align_val_t a) noexcept { counted_free(p, size_t(a)); }
+void operator delete(void* p, size_t, std::align_val_t a) noexcept { counted_free(p, size_t(a)); }
+
+struct alloc_scope_t
+{
+	size_t	count0 = alloc_count, bytes0 = alloc_bytes;
+	size_t	count() const { return alloc_count - count0; }
+	size_t	bytes() const { return alloc_bytes - bytes0; }
+};
+
+struct stopwatch_t
+{
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	double	ms() const { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count(); }
+};
+
+//*************************************
+// one row of the report; negative values are not applicable (null in JSON)
+struct result_t
+{
+	const char*	bench = "";
+	const char*	variant = "";
+	uint		n = 0;				// bodies
+	double		fraction = -1;		// packing fraction
+	uint		calls = 0;			// timed calls (steps, repeats)
+	double		ns_per_body = -1;	// per call
+	double		ns_per_pair = -1;	// per tested pair
+	double		pairs_tested = -1;	// per call
+	double		pairs_colliding = -1;	// per call
+	double		allocs = -1;		// per call
+	double		alloc_bytes = -1;	// per call
+	double		speedup = -1;		// narrowphase: scalar / simd; step: without / with the pair cache, default / ccd per simulated second
+	double		reuse = -1;			// step: fraction of the steps that reused the pair cache
+	double		dt = -1;			// integrator: step
+	double		energy_error = -1;	// integrator: max |E - E0| / |E0|
+	int			ok = -1;			// narrowphase: same result as the scalar path
+};
+
+std::vector<result_t> results;
+
+void print_result(const result_t& r)
+{
+	printf("%-11s %-16s %8u", r.bench, r.variant, r.n);
+	if (r.fraction >= 0) printf("  phi %.2f", r.fraction); else printf("          ");
+	if (r.ns_per_body >= 0) printf("  %9.2f ns/body", r.ns_per_body);
+	if (r.ns_per_pair >= 0) printf("  %7.2f ns/pair", r.ns_per_pair);
+	if (r.pairs_tested >= 0) printf("  pairs %.0f / %.0f", r.pairs_colliding, r.pairs_tested);
+	if (r.allocs >= 0) printf("  allocs %.1f (%.0f B)", r.allocs, r.alloc_bytes);
+	if (r.reuse >= 0) printf("  reuse %.0f%%", r.reuse * 100.0);
+	if (r.speedup >= 0) printf("  speedup %.2fx", r.speedup);
+	if (r.dt >= 0) printf("  dt %.4f  dE/E %.2e", r.dt, r.energy_error);
+	if (r.ok >= 0) printf("  %s", r.ok ? "ok" : "MISMATCH");
+	printf("\n");
+	fflush(stdout);
+}
+
+void add_result(const result_t& r)
+{
+	results.push_back(r);
+	print_result(r);
+}
+
+void write_number(FILE* fp, const char* key, double v, bool integer = false)
+{
+	if (v < 0) fprintf(fp, ", \"%s\": null", key);
+	else if (integer) fprintf(fp, ", \"%s\": %.0f", key, v);
+	else fprintf(fp, ", \"%s\": %.6g", key, v);
+}
+
+bool write_json(const char* path, const char* label, uint64_t seed)
+{
+	FILE* fp = fopen(path, "w");
+	if (!fp) { printf("Failed to open %s\n", path); return false; }
+	fprintf(fp, "{\n  \"format\": 1,\n  \"label\": \"%s\",\n  \"simd_width\": %d,\n  \"threads\": %u,\n  \"seed\": %llu,\n  \"results\": [\n",
+		label, SIMD_WIDTH, get_job_system().size(), (unsigned long long) seed);
+	for (size_t k = 0; k < results.size(); k++)
+	{
+		const result_t& r = results[k];
+		fprintf(fp, "    { \"bench\": \"%s\", \"variant\": \"%s\", \"n\": %u, \"calls\": %u", r.bench, r.variant, r.n, r.calls);
+		write_number(fp, "fraction", r.fraction);
+		write_number(fp, "ns_per_body", r.ns_per_body);
+		write_number(fp, "ns_per_pair", r.ns_per_pair);
+		write_number(fp, "pairs_tested", r.pairs_tested);
+		write_number(fp, "pairs_colliding", r.pairs_colliding);
+		write_number(fp, "allocs", r.allocs);
+		write_number(fp, "alloc_bytes", r.alloc_bytes, true);
+		write_number(fp, "speedup", r.speedup);
+		write_number(fp, "reuse", r.reuse);
+		write_number(fp, "dt", r.dt);
+		write_number(fp, "energy_error", r.energy_error);
+		if (r.ok >= 0) fprintf(fp, ", \"ok\": %s", r.ok ? "true" : "false");
+		fprintf(fp, " }%s\n", k + 1 < results.size() ? "," : "");
+	}
+	fprintf(fp, "  ]\n}\n");
+	fclose(fp);
+	return true;
+}
+
+// timed calls so that a case does about BODY_BUDGET body updates
+uint calls_for(uint n, uint lo, uint hi)
+{
+	return uint(std::min(std::max(BODY_BUDGET / std::max(n, 1u), double(lo)), double(hi)));
+}
+
+//*************************************
+// scenes: n equal spheres filling fraction of the Cornell box
+spawn_params_t scene_params(const std::vector<wall_t>& walls, uint n, float fraction, uint64_t seed, spawn_mode mode = SPAWN_LATTICE)
+{
+	spawn_params_t p;
+	box_interior(walls, p.lo, p.hi);
+	vec3 e = p.hi - p.lo;
+	p.count = n;
+	p.min_radius = p.max_radius = cbrtf(3.0f * fraction * e.x * e.y * e.z / (4.0f * PI * float(n)));
+	p.mode = mode;
+	p.seed = seed;
+	return p;
+}
+
+// spawned spheres never touch; a few steps bring the scene to its usual contacts
+body_store_t create_scene(const std::vector<wall_t>& walls, uint n, float fraction, uint64_t seed, uint settle = 0)
+{
+	body_store_t bodies;
+	spawn_spheres(bodies, scene_params(walls, n, fraction, seed));
+	physics_t physics;
+	float dt = (physics.b_ccd ? CCD_STEP_RATIO : 1.0f) / PHYSICS_HZ;
+	for (uint k = 0; k < settle; k++) physics.step(dt, bodies, walls);
+	return bodies;
+}
+
+// jittered lattice of side^3 spheres; fill is the radius relative to half the lattice spacing
+body_store_t create_lattice(int side, float fill, uint64_t seed = DEFAULT_SEED)
+{
+	body_store_t bodies;
+	rng_t rng(seed);
+	float spacing = 540.0f / side;
+	for (int z = 0; z < side; z++)
+	for (int y = 0; y < side; y++)
+	for (int x = 0; x < side; x++)
+	{
+		sphere_t s;
+		s.radius = spacing * 0.5f * fill * rng.randf(0.6f, 1.0f);
+		s.center = vec3((x + 0.5f) * spacing, (y + 0.5f) * spacing, -(z + 0.5f) * spacing) + rng.randf3(-0.15f, 0.15f) * spacing;
+		s.velocity = rng.randf3(-30.0f, 30.0f);
+		bodies.add(s);
+	}
+	return bodies;
+}
+
+//*************************************
+// narrowphase: SIMD against the scalar path
+void bench_run(const body_store_t& b, uint window)
+{
+	uint n = uint(b.size());
+	size_t scalar_hits = 0, simd_hits = 0;
+	double scalar_ms = 0, simd_ms = 0;
+
+	for (int r = 0; r < REPEAT; r++)
+	{
+		stopwatch_t t;
+		for (uint i = 0; i < n; i++)
+			for (uint j = i + 1, e = std::min(n, i + 1 + window); j < e; j++)
+				if (is_collide(b, i, j)) scalar_hits++;
+		scalar_ms += t.ms();
+
+		t = stopwatch_t();
+		for (uint i = 0; i < n; i++)
+		{
+			uint e = std::min(n, i + 1 + window);
+			overlap_run(b.px[i], b.py[i], b.pz[i], b.radius[i], b.px.data() + i + 1, b.py.data() + i + 1, b.pz.data() + i + 1, b.radius.data() + i + 1, e - i - 1, [&](uint) { simd_hits++; });
+		}
+		simd_ms += t.ms();
+	}
+
+	size_t tests = size_t(n) * window;
+	result_t r;
+	r.bench = "narrowphase"; r.variant = "run"; r.n = n; r.calls = REPEAT;
+	r.ns_per_pair = simd_ms * 1e6 / (tests * REPEAT);
+	r.pairs_tested = double(tests);
+	r.pairs_colliding = double(simd_hits / REPEAT);
+	r.speedup = scalar_ms / simd_ms;
+	r.ok = scalar_hits == simd_hits;
+	add_result(r);
+}
+
+//*************************************
+// spawn_spheres(): one call per mode, ns per placed body
+void bench_spawn(const std::vector<wall_t>& walls, uint n, float fraction, uint64_t seed)
+{
+	for (int m = 0; m < SPAWN_MODE_COUNT; m++)
+	{
+		spawn_params_t p = scene_params(walls, n, fraction, seed, spawn_mode(m));
+		body_store_t bodies;
+		alloc_scope_t a;
+		stopwatch_t t;
+		uint placed = spawn_spheres(bodies, p);
+		double ms = t.ms();
+
+		result_t r;
+		r.bench = "spawn"; r.variant = SPAWN_NAME[m]; r.n = placed; r.fraction = fraction; r.calls = 1;
+		r.ns_per_body = ms * 1e6 / std::max(placed, 1u);
+		r.allocs = double(a.count());
+		r.alloc_bytes = double(a.bytes());
+		add_result(r);
+	}
+}
+
+// bounce_walls() on one thread; the velocities flip back and forth, which costs the same
+void bench_walls(const std::vector<wall_t>& walls, body_store_t bodies, float fraction)
+{
+	uint n = uint(bodies.size()), calls = calls_for(n, 3, 100000);
+	std::vector<plane_t> planes;
+	get_planes(walls, planes);
+	bounce_walls(bodies, planes);
+
+	alloc_scope_t a;
+	stopwatch_t t;
+	for (uint k = 0; k < calls; k++) bounce_walls(bodies, planes);
+	double ms = t.ms();
+
+	result_t r;
+	r.bench = "walls"; r.variant = "simd"; r.n = n; r.fraction = fraction; r.calls = calls;
+	r.ns_per_body = ms * 1e6 / (double(n) * calls);
+	r.allocs = double(a.count()) / calls;
+	r.alloc_bytes = double(a.bytes()) / calls;
+	add_result(r);
+}
+
+// elastic response on the grid broadphase pairs, serial and colored parallel; the velocities
+// are restored (untimed) before each call so that every call resolves the same contacts
+void bench_elastic(const body_store_t& bodies, float fraction)
+{
+	uint n = uint(bodies.size()), calls = calls_for(n, 3, 10000);
+	uniform_grid_t grid;
+	std::vector<pair_t> pairs;
+	grid.build(bodies);
+	grid.find_pairs(bodies, pairs);
+
+	for (int parallel = 0; parallel < 2; parallel++)
+	{
+		body_store_t b = bodies;
+		contact_batches_t batches;
+		size_t contacts = parallel ? solve_contacts_parallel(b, pairs, batches) : resolve_contacts(b, pairs);
+
+		double ms = 0;
+		alloc_scope_t a;
+		for (uint k = 0; k < calls; k++)
+		{
+			b.vx = bodies.vx; b.vy = bodies.vy; b.vz = bodies.vz;
+			stopwatch_t t;
+			parallel ? solve_contacts_parallel(b, pairs, batches) : resolve_contacts(b, pairs);
+			ms += t.ms();
+		}
+
+		result_t r;
+		r.bench = "elastic"; r.variant = parallel ? "parallel" : "serial"; r.n = n; r.fraction = fraction; r.calls = calls;
+		r.ns_per_body = ms * 1e6 / (double(n) * calls);
+		r.ns_per_pair = pairs.empty() ? -1 : ms * 1e6 / (double(pairs.size()) * calls);
+		r.pairs_tested = double(grid.candidates);
+		r.pairs_colliding = double(contacts);
+		r.allocs = double(a.count()) / calls;
+		r.alloc_bytes = double(a.bytes()) / calls;
+		add_result(r);
+	}
+}
+
+// full physics_t::step() with the viewer's defaults and fixed step: without the pair cache,
+// with it (the default), then with ccd at its CCD_STEP_RATIO times longer step; all runs start
+// from the same state and take the same number of steps
+static const int STEP_RUNS = 3;
+static const char* STEP_VARIANT[STEP_RUNS] = { "", "pair cache", "ccd" };
+void bench_step(const std::vector<wall_t>& walls, const body_store_t& scene, float fraction)
+{
+	uint n = uint(scene.size()), calls = calls_for(n, 3, 200);
+	double run_ms[STEP_RUNS] = {};
+	for (int run = 0; run < STEP_RUNS; run++)
+	{
+		body_store_t bodies = scene;
+		physics_t physics;
+		physics.b_pair_cache = run != 0;
+		physics.b_ccd = run == 2;
+		float dt = (physics.b_ccd ? CCD_STEP_RATIO : 1.0f) / PHYSICS_HZ;
+		for (uint k = 0; k < WARMUP_STEPS; k++) physics.step(dt, bodies, walls);
+
+		size_t tested = 0, contacts = 0, reuses = physics.pair_cache.reuses;
+		alloc_scope_t a;
+		stopwatch_t t;
+		for (uint k = 0; k < calls; k++)
+		{
+			physics.step(dt, bodies, walls);
+			tested += physics.tested;
+			contacts += physics.contacts + (physics.b_ccd ? physics.ccd.impacts : 0);	// with ccd, the impacts as well
+		}
+		double ms = run_ms[run] = t.ms();
+
+		result_t r;
+		r.bench = "step"; r.variant = run ? STEP_VARIANT[run] : BROADPHASE_NAME[physics.broadphase]; r.n = n; r.fraction = fraction; r.calls = calls;
+		r.ns_per_body = ms * 1e6 / (double(n) * calls);
+		r.pairs_tested = double(tested) / calls;
+		r.pairs_colliding = double(contacts) / calls;
+		r.allocs = double(a.count()) / calls;
+		r.alloc_bytes = double(a.bytes()) / calls;
+		if (run == 1)
+		{
+			r.reuse = double(physics.pair_cache.reuses - reuses) / calls;
+			r.speedup = run_ms[0] / ms;
+		}
+		if (run == 2) r.speedup = run_ms[1] * CCD_STEP_RATIO / ms;	// per simulated second, against the default
+		add_result(r);
+	}
+}
+
+//*************************************
+// integrator: light bodies on eccentric orbits around the sun (planet 0), no walls
+body_store_t create_orbits(uint n, uint64_t seed)
+{
+	body_store_t bodies;
+	rng_t rng(seed);
+	sphere_t sun;
+	sun.radius = 1.0f;
+	sun.mass = PLANET_RATIO[0] * PLANET_RATIO[0] * PLANET_RATIO[0];	// the sun's mass in a small body
+	sun.tex_idx = 0;
+	bodies.add(sun);
+
+	float M = sun.mass, eps2 = GRAVITY_SOFTENING * GRAVITY_SOFTENING;
+	for (uint i = 1; i < n; i++)
+	{
+		sphere_t s;
+		s.radius = 0.5f;
+		s.mass = planet_mass(s.radius);
+		float r = rng.randf(100.0f, 400.0f);
+		vec3 u = normalize(rng.randf3(-1.0f, 1.0f)), w = normalize(cross(u, vec3(rng.randf(-0.2f, 0.2f), rng.randf(-0.2f, 0.2f), 1.0f)));
+		float circular = sqrtf(GRAVITY_G * M * r * r / (powf(r * r + eps2, 1.5f) * VELOCITY_SCALE));
+		s.center = u * r;
+		s.velocity = w * circular * rng.randf(0.8f, 1.1f);
+		bodies.add(s);
+	}
+	return bodies;
+}
+
+// steps are timed one by one; the energy is measured between them
+void bench_integrator(const body_store_t& orbits, integrator_mode mode, float dt)
+{
+	body_store_t bodies = orbits;
+	physics_t physics;
+	physics.b_gravity = true;
+	physics.gravity.theta = 0.0f;	// direct sum: a conservative field
+	physics.b_ccd = false;
+	physics.integrator = mode;
+	std::vector<wall_t> walls;
+	uint n = uint(bodies.size()), calls = uint(ORBIT_TIME / dt);
+	double e0 = physics.gravity.energy(bodies), error = 0.0, ms = 0.0;
+
+	alloc_scope_t a;
+	for (uint k = 0; k < calls; k++)
+	{
+		stopwatch_t t;
+		physics.step(dt, bodies, walls);
+		ms += t.ms();
+		error = std::max(error, fabs(physics.gravity.energy(bodies) - e0) / fabs(e0));
+	}
+
+	result_t r;
+	r.bench = "integrator"; r.variant = INTEGRATOR_NAME[mode]; r.n = n; r.calls = calls;
+	r.ns_per_body = ms * 1e6 / (double(n) * calls);
+	r.allocs = double(a.count()) / calls;
+	r.alloc_bytes = double(a.bytes()) / calls;
+	r.dt = dt;
+	r.energy_error = error;
+	add_result(r);
+}
+
+//*************************************
+// --json FILE: write the results as JSON
+// --label STR: label stored in the JSON (e.g. the version)
+// --max-spheres N: skip the sphere counts above N
+// --seed N: scene seed
+// --only NAME: run one of narrowphase, spawn, walls, elastic, step, integrator
+int main( int argc, char* argv[] )
+{
+	const char *json_path = nullptr, *label = "", *only = nullptr;
+	uint max_spheres = 1000000;
+	uint64_t seed = DEFAULT_SEED;
+	for (int k = 1; k < argc; k++)
+	{
+		if (strcmp(argv[k], "--json") == 0 && k + 1 < argc) json_path = argv[++k];
+		else if (strcmp(argv[k], "--label") == 0 && k + 1 < argc) label = argv[++k];
+		else if (strcmp(argv[k], "--max-spheres") == 0 && k + 1 < argc) max_spheres = uint(strtoul(argv[++k], nullptr, 10));
+		else if (strcmp(argv[k], "--seed") == 0 && k + 1 < argc) seed = strtoull(argv[++k], nullptr, 10);
+		else if (strcmp(argv[k], "--only") == 0 && k + 1 < argc) only = argv[++k];
+		else
+		{
+			printf("usage: %s [--json FILE] [--label STR] [--max-spheres N] [--seed N]\n", argv[0]);
+			printf("       [--only narrowphase|spawn|walls|elastic|step|integrator]\n");
+			return 1;
+		}
+	}
+	auto enabled = [&](const char* name) { return !only || strcmp(only, name) == 0; };
+
+	printf("SIMD_WIDTH = %d, %u threads\n", SIMD_WIDTH, get_job_system().size());
+	std::vector<wall_t> walls = create_cornellbox();
+
+	if (enabled("narrowphase"))
+	{
+		for (int side : { 10, 20, 40, 60 })
+		{
+			body_store_t bodies = create_lattice(side, 1.2f, seed);
+			bench_run(bodies, 64);
+		}
+	}
+
+	for (uint n : COUNTS)
+	{
+		if (n > max_spheres) break;
+		if (enabled("spawn")) bench_spawn(walls, n, DEFAULT_FRACTION, seed);
+		if (enabled("walls")) bench_walls(walls, create_scene(walls, n, DEFAULT_FRACTION, seed), DEFAULT_FRACTION);
+	}
+
+	// the pair benchmarks depend on the density as well
+	for (uint n : COUNTS)
+	{
+		if (n > max_spheres || !(enabled("elastic") || enabled("step"))) break;
+		for (float fraction : FRACTIONS)
+		{
+			body_store_t bodies = create_scene(walls, n, fraction, seed, SETTLE_STEPS);
+			if (enabled("elastic")) bench_elastic(bodies, fraction);
+			if (enabled("step")) bench_step(walls, bodies, fraction);
+		}
+	}
+
+	if (enabled("integrator"))
+	{
+		body_store_t orbits = create_orbits(ORBIT_BODIES, seed);
+		for (float dt : ORBIT_DT)
+			for (int mode = 0; mode < INTEGRATOR_COUNT; mode++) bench_integrator(orbits, integrator_mode(mode), dt);
+	}
+
+	if (json_path && !write_json(json_path, label, seed)) return 1;
+	return 0;
+}
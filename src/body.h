@@ -0,0 +1,216 @@
+#pragma once
+#ifndef __BODY_H__
+#define __BODY_H__
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/*
+* Structure-of-arrays body store
+* - the physics reads only position, velocity, radius and inverse mass,
+*   so they live in separate aligned arrays instead of inside sphere_t
+* - a render-side array holds what the sphere shader reads per instance: center, radius
+*   and texture index
+* - the simulated arrays and the per-body kernels are templates of the scalar type Real;
+*   body_store_t is the store of real: float, or double when PHYSICS_DOUBLE is defined
+*   (validation builds; half the SIMD lanes)
+*/
+static const size_t BODY_ALIGN = 32;	// AVX register width
+
+#ifdef PHYSICS_DOUBLE
+typedef double real;
+#else
+typedef float real;
+#endif
+
+template <typename T>
+struct aligned_allocator_t
+{
+	typedef T value_type;
+	aligned_allocator_t() = default;
+	template <typename U> aligned_allocator_t(const aligned_allocator_t<U>&) {}
+	template <typename U> struct rebind { typedef aligned_allocator_t<U> other; };
+
+	T*		allocate( size_t n ) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(BODY_ALIGN))); }
+	void	deallocate( T* p, size_t ) { ::operator delete(p, std::align_val_t(BODY_ALIGN)); }
+	bool	operator==( const aligned_allocator_t& ) const { return true; }
+	bool	operator!=( const aligned_allocator_t& ) const { return false; }
+};
+
+template <typename T> using aligned_array = std::vector<T, aligned_allocator_t<T>>;
+typedef aligned_array<float> float_array;
+typedef aligned_array<real> real_array;
+
+struct pair_t
+{
+	uint	a, b;	// body indices, a < b
+};
+
+// fixed rotation (x_rot * z_rot) of the texture mapping as a unit quaternion (x,y,z,w)
+static const vec4 SPHERE_ORIENTATION = vec4(-0.5f, 0.5f, 0.5f, 0.5f);
+
+// per-instance data, uploaded as is; circ.vert expands it to the model transform
+struct render_body_t
+{
+	vec4	center_radius = vec4(0.0f);	// xyz: center, w: radius
+	int		tex_idx = -1;		// texture index
+};
+
+template <typename Real>
+struct basic_body_store_t
+{
+	typedef Real			scalar;
+	typedef aligned_array<Real>	array;
+
+	array			px, py, pz;		// center
+	array			vx, vy, vz;		// velocity
+	array			radius;
+	array			inv_mass;		// 1/mass for elastic collision
+	std::vector<render_body_t>	render;	// render-side data, not touched by the solver
+
+	// public functions
+	size_t	size() const { return px.size(); }
+	void	clear();
+	void	reserve( size_t n );
+	uint	add( const sphere_t& s );
+	vec3	center( uint i ) const { return vec3(float(px[i]), float(py[i]), float(pz[i])); }
+	vec3	velocity( uint i ) const { return vec3(float(vx[i]), float(vy[i]), float(vz[i])); }
+	void	set_velocity( uint i, const vec3& v ) { vx[i] = v.x; vy[i] = v.y; vz[i] = v.z; }
+	const Real* position( int axis ) const { return axis == 0 ? px.data() : axis == 1 ? py.data() : pz.data(); }
+};
+
+typedef basic_body_store_t<real> body_store_t;
+
+template <typename Real>
+inline void basic_body_store_t<Real>::clear()
+{
+	for (array* a : { &px, &py, &pz, &vx, &vy, &vz, &radius, &inv_mass }) a->clear();
+	render.clear();
+}
+
+template <typename Real>
+inline void basic_body_store_t<Real>::reserve(size_t n)
+{
+	for (array* a : { &px, &py, &pz, &vx, &vy, &vz, &radius, &inv_mass }) a->reserve(n);
+	render.reserve(n);
+}
+
+template <typename Real>
+inline uint basic_body_store_t<Real>::add(const sphere_t& s)
+{
+	px.push_back(s.center.x); py.push_back(s.center.y); pz.push_back(s.center.z);
+	vx.push_back(s.velocity.x); vy.push_back(s.velocity.y); vz.push_back(s.velocity.z);
+	radius.push_back(s.radius);
+	inv_mass.push_back(s.mass > 0 ? Real(1) / Real(s.mass) : Real(0));
+
+	render_body_t r;
+	r.center_radius = vec4(s.center.x, s.center.y, s.center.z, s.radius);
+	r.tex_idx = s.tex_idx;
+	render.push_back(r);
+
+	return uint(size() - 1);
+}
+
+inline body_store_t create_bodies(const std::vector<sphere_t>& spheres)
+{
+	body_store_t bodies;
+	bodies.reserve(spheres.size());
+	for (auto& s : spheres) bodies.add(s);
+	return bodies;
+}
+
+template <typename Real>
+inline bool aabb_overlap(const basic_body_store_t<Real>& b, uint i, uint j)
+{
+	Real r = b.radius[i] + b.radius[j];
+	return std::abs(b.px[i] - b.px[j]) <= r && std::abs(b.py[i] - b.py[j]) <= r && std::abs(b.pz[i] - b.pz[j]) <= r;
+}
+
+template <typename Real>
+inline bool is_collide(const basic_body_store_t<Real>& b, uint i, uint j)
+{
+	Real dx = b.px[i] - b.px[j], dy = b.py[i] - b.py[j], dz = b.pz[i] - b.pz[j];
+	Real r = b.radius[i] + b.radius[j];
+	return dx * dx + dy * dy + dz * dz <= r * r;
+}
+
+// elastic response along the contact normal; tangential velocities are unchanged
+template <typename Real>
+inline void resolve_elastic(basic_body_store_t<Real>& b, uint i, uint j)
+{
+	Real nx = b.px[i] - b.px[j], ny = b.py[i] - b.py[j], nz = b.pz[i] - b.pz[j];
+	Real d2 = nx * nx + ny * ny + nz * nz;
+	if (d2 <= Real(0)) return;
+	Real inv_d = Real(1) / std::sqrt(d2);
+	nx *= inv_d; ny *= inv_d; nz *= inv_d;
+
+	// already separating
+	Real un = (b.vx[i] - b.vx[j]) * nx + (b.vy[i] - b.vy[j]) * ny + (b.vz[i] - b.vz[j]) * nz;
+	if (un >= 0) return;
+
+	Real w1 = b.inv_mass[i], w2 = b.inv_mass[j];
+	if (w1 + w2 <= Real(0)) return;
+	Real impulse = Real(-2) * un / (w1 + w2);
+	Real jx = impulse * nx, jy = impulse * ny, jz = impulse * nz;
+	b.vx[i] += w1 * jx; b.vy[i] += w1 * jy; b.vz[i] += w1 * jz;
+	b.vx[j] -= w2 * jx; b.vy[j] -= w2 * jy; b.vz[j] -= w2 * jz;
+}
+
+// hash of the simulated state of body i (bit patterns of center, velocity, radius and inverse mass)
+template <typename Real>
+inline uint64_t body_hash(const basic_body_store_t<Real>& b, uint i)
+{
+	typedef typename std::conditional<sizeof(Real) == 8, uint64_t, uint32_t>::type bits_t;
+	uint64_t h = 0x9E3779B97F4A7C15ULL * (uint64_t(i) + 1);
+	for (const aligned_array<Real>* a : { &b.px, &b.py, &b.pz, &b.vx, &b.vy, &b.vz, &b.radius, &b.inv_mass })
+	{
+		bits_t u;
+		memcpy(&u, &(*a)[i], sizeof(u));
+		h = (h ^ u) * 0x100000001B3ULL;
+		h ^= h >> 29;
+	}
+	return h;
+}
+
+// sum of body hashes (mod 2^64): independent of the order, so partial sums of any thread split agree
+template <typename Real>
+inline uint64_t state_hash(const basic_body_store_t<Real>& b, size_t begin = 0, size_t end = size_t(-1))
+{
+	uint64_t h = 0;
+	for (size_t i = begin, n = std::min(end, b.size()); i < n; i++) h += body_hash(b, uint(i));
+	return h;
+}
+
+// per-body passes work on [begin, end) so that they can be split across threads
+template <typename Real>
+inline void integrate(basic_body_store_t<Real>& b, float dt, size_t begin = 0, size_t end = size_t(-1))
+{
+	// SET MAX_DT
+	if (dt > MAX_DT) dt = MAX_DT;
+
+	Real h = Real(dt) * Real(VELOCITY_SCALE);
+	for (size_t i = begin, n = std::min(end, b.size()); i < n; i++)
+	{
+		b.px[i] += b.vx[i] * h;
+		b.py[i] += b.vy[i] * h;
+		b.pz[i] += b.vz[i] * h;
+	}
+}
+
+// largest |v| / r of [begin, end): a step of dt moves no body more than this * dt * VELOCITY_SCALE radii
+template <typename Real>
+inline float max_speed_ratio(const basic_body_store_t<Real>& b, size_t begin = 0, size_t end = size_t(-1))
+{
+	Real m = 0;
+	for (size_t i = begin, n = std::min(end, b.size()); i < n; i++)
+	{
+		Real v2 = b.vx[i] * b.vx[i] + b.vy[i] * b.vy[i] + b.vz[i] * b.vz[i], r = b.radius[i];
+		m = std::max(m, v2 / (r * r));
+	}
+	return float(std::sqrt(m));
+}
+
+#endif
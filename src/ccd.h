@@ -0,0 +1,334 @@
+#pragma once
+#ifndef __CCD_H__
+#define __CCD_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <vector>
+
+/*
+* Continuous collision detection by time of impact
+* - swept boxes (start to end of the step) are binned into every cell they overlap, the cells
+*   about twice the mean box width so a few fast bodies do not coarsen the grid for all; a
+*   moving body lists the boxes overlapping its own, each once (in the cell holding the min
+*   corner of the overlap), including bodies that would pass through each other
+* - each body advances only up to its earliest event: a sphere-sphere impact, where it stops
+*   CCD_SLOP inside the contact and gets the elastic impulse, or a wall plane, where it stops on
+*   the plane with the velocity reflected about its normal
+* - a body stopped early may be hit where it stopped, so the impacts are recomputed with the
+*   shortened motions until no time of impact decreases (conservative advancement); every
+*   iteration reads the times of the previous one and writes each body's own, so the boxes,
+*   lists, walls and iterations run per body in parallel, with the same result on any thread
+*   count; a pair is evaluated in (min,max) order from both sides, so both get the same time
+* - the time left after an event is advanced by another pass from the new velocities, up to
+*   CCD_PASSES passes per step; a body with time left after the last pass drops it (truncated),
+*   so a cluster of resting contacts cannot stall the step or tunnel
+* - the impulses of a pass are applied serially in body order (a body may be the partner of
+*   several impacts); they are few
+* - off by default (physics_t::b_ccd): the longer step does not make up for the passes (see the
+*   ccd row of bench step)
+*/
+static const float	CCD_SLOP = 0.01f;		// contact depth at the time of impact, relative to the smaller radius
+static const int	CCD_ITERATIONS = 4;		// conservative advancement iterations of a pass
+static const int	CCD_PASSES = 4;			// passes over the time left after events
+static const float	CCD_STEP_RATIO = 4.0f;	// fixed step multiplier when ccd is enabled
+static const float	CCD_CELL_WIDTHS = 2.0f;	// cell edge relative to the mean swept box width
+static const uint	CCD_BLOCK = 1024;		// bodies per block of the parallel passes
+
+// earliest s in [0,h] where |d + u*s| = r, or h when the spheres do not meet approaching
+inline float sphere_sphere_toi(vec3 d, vec3 u, float r, float h)
+{
+	float b = dot(d, u);
+	if (b >= 0.0f) return h;				// separating
+	float c = dot(d, d) - r * r;
+	if (c <= 0.0f) return 0.0f;				// already in contact and still approaching
+	float a = dot(u, u);
+	float disc = b * b - a * c;
+	if (disc < 0.0f) return h;
+	float s = c / (-b + sqrtf(disc));		// smaller root without cancellation
+	return std::min(s, h);
+}
+
+// earliest s in [0,h] where a sphere at signed distance dist moving by speed (along the normal) touches the plane
+inline float sphere_plane_toi(float dist, float speed, float r, float h)
+{
+	if (speed >= 0.0f) return h;
+	return std::min(std::max((dist - r) / -speed, 0.0f), h);
+}
+
+// time of impact when body i stops at si and body j at sj; d: relative position, ui, uj: velocities
+inline float pair_toi(vec3 d, vec3 ui, vec3 uj, float r, float si, float sj)
+{
+	float m = std::min(si, sj);
+	float s = sphere_sphere_toi(d, ui - uj, r, m);
+	if (s < m || si == sj) return s;
+
+	// only the body that stops later keeps moving
+	d += (ui - uj) * m;
+	if (si > sj) return m + sphere_sphere_toi(d, ui, r, si - m);
+	return m + sphere_sphere_toi(d, -uj, r, sj - m);
+}
+
+struct ccd_t
+{
+	real_array			lo[3], hi[3];	// swept boxes
+	vec3				origin = vec3(0);	// min corner of the boxes
+	float				cell_size = 1.0f;	// edge of a cell
+	int					dim[3] = { 1, 1, 1 };	// # of cells per axis
+	std::vector<uint>	cell_start;		// cell_start[c] ~ cell_start[c+1]: range of cell c in cell_items
+	std::vector<uint>	cell_items;		// body indices by cell, a body in every cell its box overlaps
+	std::vector<uint>	cursor;			// fill position of each cell
+	std::vector<int>	cell_lo[3];		// cell coordinates of the min corner of each box
+	std::vector<std::vector<uint>>	block_near;	// bodies whose box overlaps the box of a moving body, per block
+	std::vector<uint>	near_begin, near_end;	// range of body i in the list of its block
+	std::vector<float>	left;			// time of the step each body has not advanced yet
+	std::vector<float>	toi, next;		// advance of each body in this pass; next iteration
+	std::vector<plane_t>	planes;		// wall planes of the last step
+	std::vector<uint>	wall_hit;		// wall hit at toi: 0 none, k+1 planes[k]
+	std::vector<uint>	body_hit;		// sphere hit at toi: 0 none, j+1 body j
+	int					passes = 0;		// passes of the last step
+	size_t				impacts = 0;	// sphere impacts of the last step over all passes, a pair once per pass
+	size_t				truncated = 0;	// bodies that dropped time left after the last pass
+
+	// public functions
+	void	begin( const body_store_t& bodies, const std::vector<wall_t>& walls, float dt );
+	void	find_toi( const body_store_t& bodies, bool b_parallel );	// one pass over the time left
+	void	advance( body_store_t& bodies, size_t begin = 0, size_t end = size_t(-1) );
+	bool	resolve( body_store_t& bodies );			// impulses at the impacts of the pass; false when no time is left
+
+	// internal functions
+	void	bin_boxes();
+	int		cell_coord( real p, int axis ) const;
+	template <typename F>
+	void	for_near( uint i, F fn ) const;				// fn(j) for every box overlapping the box of i
+	void	earliest( const body_store_t& bodies, uint i, const std::vector<uint>& list );	// one iteration of body i, into next
+};
+
+inline void ccd_t::begin(const body_store_t& b, const std::vector<wall_t>& walls, float dt)
+{
+	get_planes(walls, planes);
+	left.assign(b.size(), std::min(dt, MAX_DT) * VELOCITY_SCALE);
+	passes = 0;
+	impacts = 0;
+	truncated = 0;
+}
+
+inline int ccd_t::cell_coord(real p, int axis) const
+{
+	int c = int((p - (&origin.x)[axis]) / cell_size);
+	return c < 0 ? 0 : c >= dim[axis] ? dim[axis] - 1 : c;
+}
+
+// counting sort of the boxes into the cells they overlap
+inline void ccd_t::bin_boxes()
+{
+	uint n = uint(lo[0].size());
+	vec3 blo = vec3(FLT_MAX), bhi = vec3(-FLT_MAX);
+	double width = 0.0;
+	for (int k = 0; k < 3; k++)
+	{
+		for (uint i = 0; i < n; i++)
+		{
+			(&blo.x)[k] = std::min((&blo.x)[k], float(lo[k][i]));
+			(&bhi.x)[k] = std::max((&bhi.x)[k], float(hi[k][i]));
+			width += double(hi[k][i] - lo[k][i]);
+		}
+	}
+	if (n == 0) blo = bhi = vec3(0);
+
+	origin = blo;
+	cell_size = std::max(float(CCD_CELL_WIDTHS * width / (3.0 * std::max(n, 1u))), 1e-3f);
+	size_t max_cells = GRID_CELLS_PER_BODY * n + 64;
+	for (;;)
+	{
+		for (int k = 0; k < 3; k++) dim[k] = int(((&bhi.x)[k] - (&blo.x)[k]) / cell_size) + 1;
+		if (size_t(dim[0]) * size_t(dim[1]) * size_t(dim[2]) <= max_cells) break;
+		cell_size *= 2.0f;
+	}
+
+	// every cell of the box range of each body
+	uint cells = uint(dim[0]) * uint(dim[1]) * uint(dim[2]);
+	for (int k = 0; k < 3; k++)
+	{
+		cell_lo[k].resize(n);
+		for (uint i = 0; i < n; i++) cell_lo[k][i] = cell_coord(lo[k][i], k);
+	}
+	auto for_cells = [&](uint i, auto fn)
+	{
+		int c1[3];
+		for (int k = 0; k < 3; k++) c1[k] = cell_coord(hi[k][i], k);
+		for (int z = cell_lo[2][i]; z <= c1[2]; z++)
+		for (int y = cell_lo[1][i]; y <= c1[1]; y++)
+		for (int x = cell_lo[0][i]; x <= c1[0]; x++) fn(uint((z * dim[1] + y) * dim[0] + x));
+	};
+	cell_start.assign(cells + 1, 0);
+	for (uint i = 0; i < n; i++) for_cells(i, [&](uint c) { cell_start[c + 1]++; });
+	for (uint c = 0; c < cells; c++) cell_start[c + 1] += cell_start[c];
+	cell_items.resize(cell_start[cells]);
+	cursor.assign(cell_start.begin(), cell_start.end() - 1);
+	for (uint i = 0; i < n; i++) for_cells(i, [&](uint c) { cell_items[cursor[c]++] = i; });
+}
+
+template <typename F>
+inline void ccd_t::for_near(uint i, F fn) const
+{
+	int c1[3];
+	for (int k = 0; k < 3; k++) c1[k] = cell_coord(hi[k][i], k);
+	for (int z = cell_lo[2][i]; z <= c1[2]; z++)
+	for (int y = cell_lo[1][i]; y <= c1[1]; y++)
+	for (int x = cell_lo[0][i]; x <= c1[0]; x++)
+	{
+		uint c = uint((z * dim[1] + y) * dim[0] + x);
+		for (uint t = cell_start[c]; t < cell_start[c + 1]; t++)
+		{
+			uint j = cell_items[t];
+			// overlapping boxes both are in the cell of the min corner of the overlap: the pair is
+			// reported there only
+			if (j == i || std::max(cell_lo[0][i], cell_lo[0][j]) != x || std::max(cell_lo[1][i], cell_lo[1][j]) != y || std::max(cell_lo[2][i], cell_lo[2][j]) != z) continue;
+			if (lo[0][i] > hi[0][j] || lo[0][j] > hi[0][i] || lo[1][i] > hi[1][j] || lo[1][j] > hi[1][i] || lo[2][i] > hi[2][j] || lo[2][j] > hi[2][i]) continue;
+			fn(j);
+		}
+	}
+}
+
+// body i against its near bodies with the times of the last iteration; writes only its own entries
+inline void ccd_t::earliest(const body_store_t& b, uint i, const std::vector<uint>& list)
+{
+	float s_i = toi[i];
+	for (uint k = near_begin[i]; k < near_end[i]; k++)
+	{
+		uint j = list[k], p = std::min(i, j), q = std::max(i, j);
+		float r = float(b.radius[p] + b.radius[q] - CCD_SLOP * std::min(b.radius[p], b.radius[q]));
+		float s = pair_toi(b.center(p) - b.center(q), b.velocity(p), b.velocity(q), r, toi[p], toi[q]);
+		if (s < s_i) { s_i = s; body_hit[i] = j + 1; wall_hit[i] = 0; }
+	}
+	next[i] = s_i;
+}
+
+// per-body passes over blocks of CCD_BLOCK bodies; a block writes only its bodies and its list
+inline void ccd_t::find_toi(const body_store_t& b, bool b_parallel)
+{
+	uint n = uint(b.size()), blocks = (n + CCD_BLOCK - 1) / CCD_BLOCK;
+	auto for_blocks = [&](auto fn)
+	{
+		auto body_range = [&](size_t begin, size_t end)
+		{
+			for (size_t k = begin; k < end; k++) fn(uint(k), uint(k * CCD_BLOCK), uint(std::min(size_t(n), (k + 1) * CCD_BLOCK)));
+		};
+		if (b_parallel) parallel_for(blocks, 1, body_range);
+		else body_range(0, blocks);
+	};
+
+	const real_array* p[3] = { &b.px, &b.py, &b.pz };
+	const real_array* v[3] = { &b.vx, &b.vy, &b.vz };
+	for (int k = 0; k < 3; k++) { lo[k].resize(n); hi[k].resize(n); }
+	for_blocks([&](uint, uint begin, uint end)
+	{
+		for (uint i = begin; i < end; i++)
+		{
+			real r = b.radius[i];
+			for (int k = 0; k < 3; k++)
+			{
+				real p0 = (*p[k])[i], p1 = p0 + (*v[k])[i] * left[i];
+				lo[k][i] = std::min(p0, p1) - r;
+				hi[k][i] = std::max(p0, p1) + r;
+			}
+		}
+	});
+	bin_boxes();
+
+	// near lists of the moving bodies, one list per block; bodies at rest are found by the moving ones
+	block_near.resize(blocks);
+	near_begin.resize(n);
+	near_end.resize(n);
+	for_blocks([&](uint k, uint begin, uint end)
+	{
+		std::vector<uint>& list = block_near[k];
+		list.clear();
+		for (uint i = begin; i < end; i++)
+		{
+			near_begin[i] = uint(list.size());
+			if (left[i] > 0.0f) for_near(i, [&](uint j) { list.push_back(j); });
+			near_end[i] = uint(list.size());
+		}
+	});
+
+	// first wall on the straight path
+	toi = left;
+	next.resize(n);
+	wall_hit.assign(n, 0);
+	body_hit.assign(n, 0);
+	for_blocks([&](uint, uint begin, uint end)
+	{
+		for (uint i = begin; i < end; i++)
+		{
+			if (left[i] <= 0.0f) continue;
+			for (uint k = 0; k < uint(planes.size()); k++)
+			{
+				const plane_t& w = planes[k];
+				float d = float(w.nx * b.px[i] + w.ny * b.py[i] + w.nz * b.pz[i] - w.dist);
+				float s = sphere_plane_toi(d, float(w.nx * b.vx[i] + w.ny * b.vy[i] + w.nz * b.vz[i]), float(b.radius[i]), left[i]);
+				if (s < toi[i]) { toi[i] = s; wall_hit[i] = k + 1; }
+			}
+		}
+	});
+
+	// conservative advancement
+	for (int iter = 0; iter < CCD_ITERATIONS; iter++)
+	{
+		std::atomic<bool> changed(false);
+		for_blocks([&](uint k, uint begin, uint end)
+		{
+			bool b_changed = false;
+			for (uint i = begin; i < end; i++)
+			{
+				earliest(b, i, block_near[k]);
+				b_changed |= next[i] < toi[i];
+			}
+			if (b_changed) changed = true;
+		});
+		toi.swap(next);
+		if (!changed) break;
+	}
+	passes++;
+}
+
+inline void ccd_t::advance(body_store_t& b, size_t begin, size_t end)
+{
+	for (size_t i = begin, n = std::min(end, b.size()); i < n; i++)
+	{
+		float s = toi[i];
+		b.px[i] += b.vx[i] * s;
+		b.py[i] += b.vy[i] * s;
+		b.pz[i] += b.vz[i] * s;
+		left[i] -= s;
+
+		// reflect about the normal of the wall that stopped the body
+		if (!wall_hit[i]) continue;
+		const plane_t& w = planes[wall_hit[i] - 1];
+		float k2 = 2.0f * float(w.nx * b.vx[i] + w.ny * b.vy[i] + w.nz * b.vz[i]);
+		b.vx[i] -= k2 * w.nx; b.vy[i] -= k2 * w.ny; b.vz[i] -= k2 * w.nz;
+	}
+}
+
+// serial, in body order: a body may be the partner of several impacts
+inline bool ccd_t::resolve(body_store_t& b)
+{
+	size_t remaining = 0;
+	for (uint i = 0, n = uint(b.size()); i < n; i++)
+	{
+		// the partner may have stopped short of the impact found against it
+		uint j = body_hit[i] - 1;
+		if (body_hit[i] && is_collide(b, i, j))
+		{
+			resolve_elastic(b, std::min(i, j), std::max(i, j));
+			if (!(j < i && body_hit[j] == i + 1)) impacts++;	// two bodies stopped at each other are one impact
+		}
+		if (left[i] > 0.0f) remaining++;
+	}
+	if (remaining && passes == CCD_PASSES) truncated = remaining;
+	return remaining > 0;
+}
+
+#endif
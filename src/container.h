@@ -0,0 +1,84 @@
+#pragma once
+#ifndef __CONTAINER_H__
+#define __CONTAINER_H__
+
+#include <vector>
+
+/*
+* Container collision against a convex set of wall planes
+* - a wall is the half space dot(normal, p) >= dist; the container is the intersection of
+*   any number of them, so boxes, prisms or any convex polyhedron work the same way
+* - a sphere closer than its radius and moving toward the plane is reflected about the true
+*   normal: v -= 2 (v.n) n; for an axis-aligned normal this is the exact sign flip
+* - SIMD_WIDTH bodies per block with the planes broadcast, walls applied in list order;
+*   the remaining bodies run the scalar tail with the same arithmetic
+* - plane_t stays float (walls are float geometry); the kernel runs in the body store's Real
+*/
+struct plane_t
+{
+	float	nx, ny, nz, dist;
+};
+
+inline void get_planes(const std::vector<wall_t>& walls, std::vector<plane_t>& planes)
+{
+	planes.resize(walls.size());
+	for (size_t k = 0; k < walls.size(); k++) planes[k] = plane_t{ walls[k].normal.x, walls[k].normal.y, walls[k].normal.z, walls[k].dist };
+}
+
+// per-body passes work on [begin, end) so that they can be split across threads
+template <typename Real>
+inline void bounce_walls(basic_body_store_t<Real>& b, const plane_t* planes, size_t count, size_t begin = 0, size_t end = size_t(-1))
+{
+	typedef typename simd_of<Real>::type simd;
+	typedef typename simd_of<Real>::mask mask;
+	const size_t W = simd_of<Real>::width;
+	size_t i = begin, n = std::min(end, b.size());
+	const simd zero = simd_set1(Real(0));
+	for (; i + W <= n; i += W)
+	{
+		simd px = simd_load(b.px.data() + i), py = simd_load(b.py.data() + i), pz = simd_load(b.pz.data() + i);
+		simd vx = simd_load(b.vx.data() + i), vy = simd_load(b.vy.data() + i), vz = simd_load(b.vz.data() + i);
+		simd r = simd_load(b.radius.data() + i);
+		int touched = 0;
+		for (size_t k = 0; k < count; k++)
+		{
+			const plane_t& w = planes[k];
+			simd nx = simd_set1(Real(w.nx)), ny = simd_set1(Real(w.ny)), nz = simd_set1(Real(w.nz));
+			simd d = simd_sub(simd_add(simd_add(simd_mul(nx, px), simd_mul(ny, py)), simd_mul(nz, pz)), simd_set1(Real(w.dist)));
+			simd vn = simd_add(simd_add(simd_mul(nx, vx), simd_mul(ny, vy)), simd_mul(nz, vz));
+			mask hit = simd_and(simd_lt(d, r), simd_lt(vn, zero));
+			int bits = simd_bits(hit);
+			if (!bits) continue;
+			touched |= bits;
+			simd k2 = simd_add(vn, vn);
+			vx = simd_select(hit, simd_sub(vx, simd_mul(k2, nx)), vx);
+			vy = simd_select(hit, simd_sub(vy, simd_mul(k2, ny)), vy);
+			vz = simd_select(hit, simd_sub(vz, simd_mul(k2, nz)), vz);
+		}
+		if (!touched) continue;
+		simd_store(b.vx.data() + i, vx); simd_store(b.vy.data() + i, vy); simd_store(b.vz.data() + i, vz);
+	}
+
+	// scalar tail
+	for (; i < n; i++)
+	{
+		for (size_t k = 0; k < count; k++)
+		{
+			const plane_t& w = planes[k];
+			Real nx = w.nx, ny = w.ny, nz = w.nz;
+			Real d = nx * b.px[i] + ny * b.py[i] + nz * b.pz[i] - Real(w.dist);
+			Real vn = nx * b.vx[i] + ny * b.vy[i] + nz * b.vz[i];
+			if (!(d < b.radius[i] && vn < Real(0))) continue;
+			Real k2 = vn + vn;
+			b.vx[i] -= k2 * nx; b.vy[i] -= k2 * ny; b.vz[i] -= k2 * nz;
+		}
+	}
+}
+
+template <typename Real>
+inline void bounce_walls(basic_body_store_t<Real>& b, const std::vector<plane_t>& planes, size_t begin = 0, size_t end = size_t(-1))
+{
+	bounce_walls(b, planes.data(), planes.size(), begin, end);
+}
+
+#endif
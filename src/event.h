@@ -0,0 +1,275 @@
+#pragma once
+#ifndef __EVENT_H__
+#define __EVENT_H__
+
+#include <cfloat>
+#include <queue>
+#include <vector>
+
+/*
+* Event-driven hard-sphere engine
+* - spheres fly on straight lines between events, so the exact times of sphere-sphere
+*   and sphere-wall contacts are predicted instead of stepping
+* - events are processed in time order from a priority queue; every event of a body
+*   records the body's event counter, and an event whose counter is outdated is dropped
+*   when popped (lazy invalidation)
+* - only the events up to the end of the current advance are in the queue; the later ones wait
+*   in a plain list, whose outdated events are dropped when the next advance takes its share, so the
+*   heap stays small enough for the cache (most predicted events lie beyond the frame)
+* - bodies are binned in a grid whose cell edge is at least the largest diameter, so a body
+*   only predicts contacts with the 27 cells around it; entering a cell is an event too, which
+*   keeps the queued contacts (the path is unchanged) and only predicts the 9 new neighbor cells
+* - in a sparse scene the cell edge follows the density instead (EVENT_BODIES_PER_CELL): cells of
+*   the largest diameter would be mostly empty and only add crossing events, while cells holding
+*   more than one body cost more sphere predictions than the crossings they save
+* - the container is the axis-aligned box of walls 0~5 (the grid covers it); other convex
+*   containers need the time-stepping engine
+* - bodies are drifted lazily: each keeps the time of its last event, and all of them are
+*   brought to the current time at the end of advance(); positions are drifted in real
+*/
+static const uint EVENT_CELLS_PER_BODY = 4;	// upper bound of (# of cells) / (# of bodies)
+static const float EVENT_BODIES_PER_CELL = 0.25f;	// mean bodies per cell of a sparse scene
+
+enum event_type { EVENT_SPHERE = 0, EVENT_WALL, EVENT_CELL };
+
+struct event_t
+{
+	double	time;
+	uint	a, b;			// bodies; EVENT_WALL: b = axis, EVENT_CELL: b = cell entered
+	uint	count_a, count_b;	// event counters at prediction
+	uint	type;
+
+	bool	operator>( const event_t& e ) const { return time > e.time || (time == e.time && (a > e.a || (a == e.a && b > e.b))); }
+};
+
+struct event_engine_t
+{
+	double				now = 0.0;			// scaled time (position += velocity * time)
+	std::vector<double>	body_time;			// time of the last drift of each body
+	std::vector<uint>	count;				// event counter of each body
+	double				target = 0.0;		// end of the current advance
+	std::priority_queue<event_t, std::vector<event_t>, std::greater<event_t>> queue;	// events up to target
+	std::vector<event_t>	later;			// events after target, unordered
+	vec3				lo = vec3(0), hi = vec3(0);	// box interior
+	float				cell_size = 1.0f;
+	int					dim[3] = { 1, 1, 1 };
+	std::vector<std::vector<uint>>	cells;	// bodies of each cell
+	std::vector<uint>	body_cell, slot;	// cell of each body and its index in the cell
+	size_t				collisions = 0;		// sphere-sphere events of the last advance
+	size_t				events = 0;			// valid events of the last advance
+
+	// public functions
+	void	clear();
+	void	reset( body_store_t& bodies, const std::vector<wall_t>& walls );
+	size_t	advance( body_store_t& bodies, const std::vector<wall_t>& walls, float dt );	// returns collisions
+
+	// internal functions
+	bool	is_outdated( const event_t& e ) const { return e.count_a != count[e.a] || (e.type == EVENT_SPHERE && e.count_b != count[e.b]); }
+	void	schedule( const event_t& e ) { if (e.time <= target) queue.push(e); else later.push_back(e); }
+	void	drift( body_store_t& bodies, uint i );
+	void	position_at( const body_store_t& bodies, uint i, double t, real* p ) const;
+	int		cell_coord( real p, int axis ) const;
+	uint	cell_index( int x, int y, int z ) const { return (uint(z) * dim[1] + uint(y)) * dim[0] + uint(x); }
+	void	move_to_cell( uint i, uint c );
+	void	predict( const body_store_t& bodies, uint i, int axis = -1, int dir = 0 );	// axis, dir: entered cell
+};
+
+inline void event_engine_t::clear()
+{
+	queue = decltype(queue)();
+	later.clear();
+	body_time.clear();
+	count.clear();
+	cells.clear();
+	body_cell.clear();
+	slot.clear();
+	now = target = 0.0;
+}
+
+inline int event_engine_t::cell_coord(real p, int axis) const
+{
+	int c = int((p - (&lo.x)[axis]) / cell_size);
+	return c < 0 ? 0 : c >= dim[axis] ? dim[axis] - 1 : c;
+}
+
+inline void event_engine_t::position_at(const body_store_t& b, uint i, double t, real* p) const
+{
+	real s = real(t - body_time[i]);
+	p[0] = b.px[i] + b.vx[i] * s;
+	p[1] = b.py[i] + b.vy[i] * s;
+	p[2] = b.pz[i] + b.vz[i] * s;
+}
+
+inline void event_engine_t::drift(body_store_t& b, uint i)
+{
+	real p[3];
+	position_at(b, i, now, p);
+	b.px[i] = p[0]; b.py[i] = p[1]; b.pz[i] = p[2];
+	body_time[i] = now;
+}
+
+inline void event_engine_t::move_to_cell(uint i, uint c)
+{
+	std::vector<uint>& from = cells[body_cell[i]];
+	uint last = from.back();
+	from[slot[i]] = last;
+	slot[last] = slot[i];
+	from.pop_back();
+
+	body_cell[i] = c;
+	slot[i] = uint(cells[c].size());
+	cells[c].push_back(i);
+}
+
+inline void event_engine_t::reset(body_store_t& b, const std::vector<wall_t>& walls)
+{
+	clear();
+	uint n = uint(b.size());
+
+	box_interior(walls, lo, hi);
+
+	// cell edge >= largest diameter and >= the edge of EVENT_BODIES_PER_CELL at the mean density;
+	// grow it if a flat box would still allocate too many cells
+	float max_radius = 0.0f;
+	for (uint i = 0; i < n; i++) max_radius = std::max(max_radius, float(b.radius[i]));
+	vec3 extent = hi - lo;
+	float density_edge = cbrtf(extent.x * extent.y * extent.z * EVENT_BODIES_PER_CELL / float(std::max(n, 1u)));
+	cell_size = std::max(std::max(2.0f * max_radius, density_edge), 1e-3f);
+	for (size_t max_cells = EVENT_CELLS_PER_BODY * size_t(n) + 64;; cell_size *= 2.0f)
+	{
+		for (int k = 0; k < 3; k++) dim[k] = std::max(1, int((&extent.x)[k] / cell_size));
+		if (size_t(dim[0]) * dim[1] * dim[2] <= max_cells) break;
+	}
+	for (int k = 0; k < 3; k++) if ((&extent.x)[k] > 0.0f) cell_size = std::max(cell_size, (&extent.x)[k] / dim[k]);
+
+	cells.resize(size_t(dim[0]) * dim[1] * dim[2]);
+	body_time.assign(n, 0.0);
+	count.assign(n, 0);
+	body_cell.resize(n);
+	slot.resize(n);
+	for (uint i = 0; i < n; i++)
+	{
+		uint c = cell_index(cell_coord(b.px[i], 0), cell_coord(b.py[i], 1), cell_coord(b.pz[i], 2));
+		body_cell[i] = c;
+		slot[i] = uint(cells[c].size());
+		cells[c].push_back(i);
+	}
+	for (uint i = 0; i < n; i++) predict(b, i);
+}
+
+// wall or cell boundary crossing, and contacts with the 27 neighbor cells or the 9 new ones after entering a cell
+inline void event_engine_t::predict(const body_store_t& b, uint i, int axis, int dir)
+{
+	real p[3], v[3] = { b.vx[i], b.vy[i], b.vz[i] };
+	position_at(b, i, now, p);
+	float r = float(b.radius[i]);
+	int c[3] = { int(body_cell[i] % dim[0]), int(body_cell[i] / dim[0] % dim[1]), int(body_cell[i] / dim[0] / dim[1]) };
+
+	// earliest wall or cell boundary
+	float horizon = FLT_MAX;
+	event_t e = { 0.0, i, 0, count[i], 0, EVENT_WALL };
+	for (int k = 0; k < 3; k++)
+	{
+		real pk = p[k];
+		float vk = float(v[k]);
+		float t = std::min(sphere_plane_toi(float(pk - (&lo.x)[k]), vk, r, FLT_MAX), sphere_plane_toi(float((&hi.x)[k] - pk), -vk, r, FLT_MAX));
+		if (t < horizon) { horizon = t; e.type = EVENT_WALL; e.b = uint(k); }
+
+		int next = c[k] + (vk > 0.0f ? 1 : -1);
+		if (vk == 0.0f || next < 0 || next >= dim[k]) continue;
+		real boundary = real((&lo.x)[k]) + real(cell_size) * real(vk > 0.0f ? c[k] + 1 : c[k]);
+		t = std::max(float((boundary - pk) / v[k]), 0.0f);
+		if (t < horizon)
+		{
+			int d[3] = { c[0], c[1], c[2] };
+			d[k] = next;
+			horizon = t; e.type = EVENT_CELL; e.b = cell_index(d[0], d[1], d[2]);
+		}
+	}
+	if (horizon < FLT_MAX) { e.time = now + horizon; schedule(e); }
+
+	// neighbor cells; after entering a cell only the layer ahead is new
+	int from[3], to[3];
+	for (int k = 0; k < 3; k++) { from[k] = std::max(c[k] - 1, 0); to[k] = std::min(c[k] + 1, dim[k] - 1); }
+	if (axis >= 0)
+	{
+		from[axis] = to[axis] = c[axis] + dir;
+		if (from[axis] < 0 || from[axis] >= dim[axis]) return;
+	}
+	for (int z = from[2]; z <= to[2]; z++)
+	for (int y = from[1]; y <= to[1]; y++)
+	for (int x = from[0]; x <= to[0]; x++)
+	{
+		for (uint j : cells[cell_index(x, y, z)])
+		{
+			if (j == i) continue;
+			real q[3];
+			position_at(b, j, now, q);
+			vec3 d(float(p[0] - q[0]), float(p[1] - q[1]), float(p[2] - q[2])), u(float(v[0] - b.vx[j]), float(v[1] - b.vy[j]), float(v[2] - b.vz[j]));
+			float t = sphere_sphere_toi(d, u, r + float(b.radius[j]), FLT_MAX);
+			if (t == FLT_MAX) continue;
+			schedule(event_t{ now + t, std::min(i, j), std::max(i, j), count[std::min(i, j)], count[std::max(i, j)], EVENT_SPHERE });
+		}
+	}
+}
+
+inline size_t event_engine_t::advance(body_store_t& b, const std::vector<wall_t>& walls, float dt)
+{
+	if (count.size() != b.size()) reset(b, walls);
+	target = now + double(std::min(dt, MAX_DT) * VELOCITY_SCALE);
+	collisions = events = 0;
+
+	// the events of this advance into the queue; the order of a tie is fixed by the bodies
+	size_t kept = 0;
+	for (const event_t& e : later)
+	{
+		if (is_outdated(e)) continue;
+		if (e.time <= target) queue.push(e);
+		else later[kept++] = e;
+	}
+	later.resize(kept);
+
+	while (!queue.empty())
+	{
+		event_t e = queue.top();
+		queue.pop();
+		if (is_outdated(e)) continue;
+		events++;
+
+		now = std::max(now, e.time);
+		drift(b, e.a);
+		if (e.type == EVENT_CELL)
+		{
+			// same path: queued contacts stay valid
+			uint from = body_cell[e.a];
+			int axis = from % dim[0] != e.b % dim[0] ? 0 : from / dim[0] % dim[1] != e.b / dim[0] % dim[1] ? 1 : 2;
+			int dir = e.b > from ? 1 : -1;
+			move_to_cell(e.a, e.b);
+			predict(b, e.a, axis, dir);
+			continue;
+		}
+
+		count[e.a]++;
+		if (e.type == EVENT_SPHERE)
+		{
+			drift(b, e.b);
+			count[e.b]++;
+			resolve_elastic(b, e.a, e.b);
+			collisions++;
+			predict(b, e.b);
+		}
+		else
+		{
+			real* v[3] = { &b.vx[e.a], &b.vy[e.a], &b.vz[e.a] };
+			*v[e.b] = -*v[e.b];
+		}
+		predict(b, e.a);
+	}
+
+	// bring every body to the target time; the predicted events stay valid
+	now = target;
+	for (uint i = 0, n = uint(b.size()); i < n; i++) drift(b, i);
+	return collisions;
+}
+
+#endif
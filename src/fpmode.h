@@ -0,0 +1,23 @@
+#pragma once
+#ifndef __FPMODE_H__
+#define __FPMODE_H__
+
+/*
+* Floating-point contraction off for the whole translation unit
+* - with FMA available (-mfma, -march=native, AVX-512), compilers may fuse a*b+c into one fma
+*   with a single rounding; they do it in scalar code and intrinsics alike, but not the same
+*   way in a SIMD block and in the scalar tail of a kernel, so a body's result would depend on
+*   the lane it ran in, and deterministic hashes on the thread count
+* - included first in every .cpp: gcc only honors the setting for functions defined after it,
+*   and does not inline across functions with different settings
+* - gcc ignores the STDC pragma; msvc only contracts with /fp:contract (off by default)
+*/
+#if defined(__clang__)
+	#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+	#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+	#pragma fp_contract(off)
+#endif
+
+#endif
@@ -0,0 +1,188 @@
+#pragma once
+#ifndef __GRAVITY_H__
+#define __GRAVITY_H__
+
+#include <vector>
+
+/*
+* Mutual gravity by Barnes-Hut
+* - the octree is rebuilt every step; a cell whose edge / distance is below theta (the opening
+*   angle) acts through its center of mass, closer cells are opened, leaves are summed directly
+* - the walk is shared by the bodies of a group, the largest cell of at most GRAVITY_GROUP_SIZE
+*   bodies (distance measured to the group's cube), and the resulting interaction list is summed
+*   SIMD_WIDTH entries at a time
+* - Plummer softening keeps the force finite at close range
+* - the gravitational mass is the collision mass (1 / inv_mass), read every step, so contacts and
+*   gravity exchange momentum with the same masses; set_density_masses() gives every body a
+*   uniform density, (radius / EARTH_RADIUS)^3 Earth masses; immovable bodies (inv_mass 0) do
+*   not attract
+* - accelerations() only evaluates the field at the current centers; the kicks v += G*a*dt are
+*   placed by the integrator policy (see integrator.h)
+* - energy() is the quantity the gravity flow conserves (direct sum): sum m*VELOCITY_SCALE*|v|^2/2
+*   minus G * sum m_i*m_j / sqrt(d^2 + softening^2); elastic contacts and walls only change
+*   velocities and keep the kinetic part, so they conserve it as well
+*/
+static const float GRAVITY_G = 0.15f;			// acceleration (velocity/s) of one Earth mass at unit distance
+static const float GRAVITY_THETA = 0.5f;		// default opening angle
+static const float GRAVITY_SOFTENING = 5.0f;	// Plummer radius
+static const float EARTH_RADIUS = 10.0f;		// radius of one Earth mass
+static const uint GRAVITY_GROUP_SIZE = 64;		// max bodies sharing one tree walk
+
+// Earth masses of a body of uniform density
+inline float planet_mass(float radius)
+{
+	float r = radius / EARTH_RADIUS;
+	return r * r * r;
+}
+
+// collision masses of uniform density; gravity reads them back (see gravity_t::update_masses)
+inline void set_density_masses(body_store_t& b)
+{
+	for (size_t i = 0, n = b.size(); i < n; i++) b.inv_mass[i] = real(1) / real(planet_mass(float(b.radius[i])));
+}
+
+// cells and bodies acting on one group, padded with zero masses to a multiple of SIMD_WIDTH
+struct interaction_list_t
+{
+	float_array	x, y, z, m;
+
+	void	clear() { x.clear(); y.clear(); z.clear(); m.clear(); }
+	void	push( vec3 p, float mass ) { x.push_back(p.x); y.push_back(p.y); z.push_back(p.z); m.push_back(mass); }
+	void	pad() { while (m.size() % SIMD_WIDTH) push(vec3(0), 0.0f); }
+	vec3	acceleration( vec3 p, float eps2 ) const;
+};
+
+// softened sum over the list; lanes are added in a fixed order so the result does not depend on threads
+inline vec3 interaction_list_t::acceleration(vec3 p, float eps2) const
+{
+	simdf cx = simd_set1(p.x), cy = simd_set1(p.y), cz = simd_set1(p.z), e = simd_set1(eps2);
+	simdf ax = simd_set1(0.0f), ay = ax, az = ax;
+	for (size_t k = 0; k < m.size(); k += SIMD_WIDTH)
+	{
+		simdf dx = simd_sub(simd_load(x.data() + k), cx), dy = simd_sub(simd_load(y.data() + k), cy), dz = simd_sub(simd_load(z.data() + k), cz);
+		simdf d2 = simd_add(simd_add(simd_add(simd_mul(dx, dx), simd_mul(dy, dy)), simd_mul(dz, dz)), e);
+		simdf w = simd_div(simd_load(m.data() + k), simd_mul(d2, simd_sqrt(d2)));
+		ax = simd_add(ax, simd_mul(dx, w)); ay = simd_add(ay, simd_mul(dy, w)); az = simd_add(az, simd_mul(dz, w));
+	}
+	alignas(64) float lx[SIMD_WIDTH], ly[SIMD_WIDTH], lz[SIMD_WIDTH];
+	simd_store(lx, ax); simd_store(ly, ay); simd_store(lz, az);
+	vec3 a = vec3(0);
+	for (int l = 0; l < SIMD_WIDTH; l++) a += vec3(lx[l], ly[l], lz[l]);
+	return a;
+}
+
+struct gravity_t
+{
+	octree_t			tree;
+	float_array			mass;		// gravitational mass of each body (1 / inv_mass) at the last update_masses()
+	float_array			ax, ay, az;	// acceleration of each body at the last accelerations() (times G: velocity/s)
+	std::vector<uint>	groups;		// nodes sharing one tree walk
+	float				theta = GRAVITY_THETA;
+	float				G = GRAVITY_G;
+	float				softening = GRAVITY_SOFTENING;
+
+	// public functions
+	void	accelerations( const body_store_t& bodies );
+	double	energy( const body_store_t& bodies, double* kinetic = nullptr );	// O(N^2)
+
+	// internal functions
+	void	update_masses( const body_store_t& bodies );
+	void	build_list( const body_store_t& bodies, uint group, interaction_list_t& list ) const;
+};
+
+// walks the tree once per group: a cell far enough from every point of the group's cube acts
+// through its center of mass, otherwise it is opened; the group's own bodies end up summed
+// directly (a body's own term is zero as its offset is zero)
+inline void gravity_t::build_list(const body_store_t& b, uint group, interaction_list_t& list) const
+{
+	const octree_node_t& L = tree.nodes[group];
+	float theta2 = theta * theta;
+	list.clear();
+
+	uint stack[8 * OCTREE_MAX_DEPTH + 8], top = 0;
+	stack[top++] = 0;
+	while (top)
+	{
+		const octree_node_t& n = tree.nodes[stack[--top]];
+		bool contains = n.begin <= L.begin && L.end <= n.end;
+		if (!contains)
+		{
+			vec3 d = vec3(std::max(fabsf(n.com.x - L.center.x) - L.half, 0.0f), std::max(fabsf(n.com.y - L.center.y) - L.half, 0.0f), std::max(fabsf(n.com.z - L.center.z) - L.half, 0.0f));
+			float edge = 2.0f * n.half;
+			if (edge * edge < theta2 * dot(d, d)) { list.push(n.com, n.mass); continue; }
+		}
+		if (!n.is_leaf()) { for (uint c = n.child; c < n.child + n.child_count; c++) stack[top++] = c; continue; }
+		for (uint k = n.begin; k < n.end; k++)
+		{
+			uint j = tree.order[k];
+			list.push(b.center(j), mass[j]);
+		}
+	}
+	list.pad();
+}
+
+// read every call: the masses may be edited or loaded with the same body count
+inline void gravity_t::update_masses(const body_store_t& b)
+{
+	size_t n = b.size();
+	mass.resize(n);
+	for (size_t i = 0; i < n; i++) mass[i] = b.inv_mass[i] > 0 ? float(real(1) / b.inv_mass[i]) : 0.0f;
+}
+
+inline void gravity_t::accelerations(const body_store_t& b)
+{
+	uint n = uint(b.size());
+	update_masses(b);
+	ax.resize(n); ay.resize(n); az.resize(n);
+	tree.build(b, mass.data());
+	groups.clear();
+	if (!tree.nodes.empty())
+	{
+		std::vector<uint> stack(1, 0);
+		while (!stack.empty())
+		{
+			uint k = stack.back();
+			stack.pop_back();
+			const octree_node_t& node = tree.nodes[k];
+			if (node.is_leaf() || node.end - node.begin <= GRAVITY_GROUP_SIZE) groups.push_back(k);
+			else for (uint c = node.child; c < node.child + node.child_count; c++) stack.push_back(c);
+		}
+	}
+
+	float eps2 = softening * softening;
+	parallel_for(groups.size(), 4, [&](size_t begin, size_t end)
+	{
+		interaction_list_t list;
+		for (size_t g = begin; g < end; g++)
+		{
+			build_list(b, groups[g], list);
+			const octree_node_t& L = tree.nodes[groups[g]];
+			for (uint k = L.begin; k < L.end; k++)
+			{
+				uint i = tree.order[k];
+				vec3 a = list.acceleration(b.center(i), eps2);
+				ax[i] = a.x; ay[i] = a.y; az[i] = a.z;
+			}
+		}
+	});
+}
+
+inline double gravity_t::energy(const body_store_t& b, double* kinetic_part)
+{
+	uint n = uint(b.size());
+	update_masses(b);
+	double kinetic = 0.0, potential = 0.0, eps2 = double(softening) * softening;
+	for (uint i = 0; i < n; i++)
+	{
+		kinetic += 0.5 * mass[i] * VELOCITY_SCALE * (double(b.vx[i]) * b.vx[i] + double(b.vy[i]) * b.vy[i] + double(b.vz[i]) * b.vz[i]);
+		for (uint j = i + 1; j < n; j++)
+		{
+			double dx = double(b.px[i]) - b.px[j], dy = double(b.py[i]) - b.py[j], dz = double(b.pz[i]) - b.pz[j];
+			potential -= double(mass[i]) * mass[j] / std::sqrt(dx * dx + dy * dy + dz * dz + eps2);
+		}
+	}
+	if (kinetic_part) *kinetic_part = kinetic;
+	return kinetic + G * potential;
+}
+
+#endif
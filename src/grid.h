@@ -0,0 +1,145 @@
+#pragma once
+#ifndef __GRID_H__
+#define __GRID_H__
+
+#include <cfloat>
+#include <vector>
+
+/*
+* Uniform grid broadphase
+* - every sphere is binned into exactly one cell by its center
+* - the cell edge is at least the largest diameter, so an overlapping pair
+*   is always found in the same cell or in one of the 26 neighbors
+* - bodies are sorted by cell with a counting sort, rebuilt every step
+* - centers and radii are also copied in cell order, so a cell is a contiguous run
+*   and the sphere overlap test runs SIMD_WIDTH candidates at a time
+*/
+static const uint GRID_CELLS_PER_BODY = 4;	// upper bound of (# of cells) / (# of bodies)
+
+struct uniform_grid_t
+{
+	vec3				origin = vec3(0);	// min corner of the gridded volume
+	float				cell_size = 1.0f;	// edge length of a cell
+	int					dim[3] = { 1, 1, 1 };	// # of cells per axis
+	std::vector<uint>	cell_start;			// cell_start[c] ~ cell_start[c+1]: range of cell c in cell_items
+	std::vector<uint>	cell_items;			// body indices sorted by cell
+	std::vector<uint>	body_cell;			// cell index of each body
+	real_array			sx, sy, sz, sr;		// centers and radii in cell order
+	mutable size_t		candidates = 0;		// cell-neighbor pairs sphere-tested by the last find_pairs()
+
+	// public functions
+	void	build( const body_store_t& bodies );
+	void	find_pairs( const body_store_t& bodies, std::vector<pair_t>& pairs ) const;	// reads the copies made by build(); bodies is unused, kept for parity with sap and tree
+	int		cell_coord( real p, int axis ) const;
+	uint	cell_count() const { return uint(dim[0]) * uint(dim[1]) * uint(dim[2]); }
+};
+
+inline int uniform_grid_t::cell_coord(real p, int axis) const
+{
+	int c = int((p - (&origin.x)[axis]) / cell_size);
+	return c < 0 ? 0 : c >= dim[axis] ? dim[axis] - 1 : c;
+}
+
+inline void uniform_grid_t::build(const body_store_t& bodies)
+{
+	size_t n = bodies.size();
+
+	// bounds of centers and the largest radius
+	vec3 lo = vec3(FLT_MAX), hi = vec3(-FLT_MAX);
+	float max_radius = 0.0f;
+	for (size_t i = 0; i < n; i++)
+	{
+		vec3 c = bodies.center(uint(i));
+		lo = vec3(std::min(lo.x, c.x), std::min(lo.y, c.y), std::min(lo.z, c.z));
+		hi = vec3(std::max(hi.x, c.x), std::max(hi.y, c.y), std::max(hi.z, c.z));
+		max_radius = std::max(max_radius, float(bodies.radius[i]));
+	}
+	if (n == 0) lo = hi = vec3(0);
+
+	// cell edge >= largest diameter; grow it if a sparse scene would allocate too many cells
+	origin = lo;
+	cell_size = std::max(2.0f * max_radius, 1e-3f);
+	size_t max_cells = GRID_CELLS_PER_BODY * n + 64;
+	for (;;)
+	{
+		dim[0] = int((hi.x - lo.x) / cell_size) + 1;
+		dim[1] = int((hi.y - lo.y) / cell_size) + 1;
+		dim[2] = int((hi.z - lo.z) / cell_size) + 1;
+		if (size_t(dim[0]) * size_t(dim[1]) * size_t(dim[2]) <= max_cells) break;
+		cell_size *= 2.0f;
+	}
+
+	// counting sort of bodies by cell
+	uint cells = cell_count();
+	cell_start.assign(cells + 1, 0);
+	body_cell.resize(n);
+	for (size_t i = 0; i < n; i++)
+	{
+		uint cell = uint((cell_coord(bodies.pz[i], 2) * dim[1] + cell_coord(bodies.py[i], 1)) * dim[0] + cell_coord(bodies.px[i], 0));
+		body_cell[i] = cell;
+		cell_start[cell + 1]++;
+	}
+	for (uint c = 0; c < cells; c++) cell_start[c + 1] += cell_start[c];
+
+	cell_items.resize(n);
+	sx.resize(n); sy.resize(n); sz.resize(n); sr.resize(n);
+	std::vector<uint> cursor(cell_start.begin(), cell_start.end() - 1);
+	for (size_t i = 0; i < n; i++)
+	{
+		uint k = cursor[body_cell[i]]++;
+		cell_items[k] = uint(i);
+		sx[k] = bodies.px[i]; sy[k] = bodies.py[i]; sz[k] = bodies.pz[i]; sr[k] = bodies.radius[i];
+	}
+}
+
+inline void uniform_grid_t::find_pairs(const body_store_t&, std::vector<pair_t>& pairs) const
+{
+	// half of the 26 neighbors, so that every pair of cells is visited once:
+	// (+1,0,0) and the rows (y,z) + { (1,0), (-1,1), (0,1), (1,1) } with x-1 ~ x+1
+	// three neighboring cells of a row are one contiguous run in the sorted arrays
+	static const int rows[4][2] = { { 1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 } };
+
+	pairs.clear();
+	candidates = 0;
+
+	// sorted slot k against the contiguous slots [b, e)
+	auto test_run = [&](uint k, uint b, uint e)
+	{
+		if (b >= e) return;
+		candidates += e - b;
+		uint i = cell_items[k];
+		overlap_run(sx[k], sy[k], sz[k], sr[k], sx.data() + b, sy.data() + b, sz.data() + b, sr.data() + b, e - b, [&](uint l)
+		{
+			uint j = cell_items[b + l];
+			pairs.push_back(i < j ? pair_t{ i, j } : pair_t{ j, i });
+		});
+	};
+
+	for (int z = 0; z < dim[2]; z++)
+	for (int y = 0; y < dim[1]; y++)
+	{
+		uint row = uint((z * dim[1] + y) * dim[0]);
+		for (int x = 0; x < dim[0]; x++)
+		{
+			uint b = cell_start[row + x], e = cell_start[row + x + 1];
+			if (b == e) continue;
+			int x0 = std::max(x - 1, 0), x1 = std::min(x + 1, dim[0] - 1);
+
+			// rest of the cell and the +x neighbor
+			uint own_end = cell_start[row + x1 + 1];
+			for (uint k = b; k < e; k++) test_run(k, k + 1, own_end);
+
+			// forward rows
+			for (auto& r : rows)
+			{
+				int ny = y + r[0], nz = z + r[1];
+				if (ny < 0 || ny >= dim[1] || nz >= dim[2]) continue;
+				uint nrow = uint((nz * dim[1] + ny) * dim[0]);
+				uint rb = cell_start[nrow + x0], re = cell_start[nrow + x1 + 1];
+				for (uint k = b; k < e; k++) test_run(k, rb, re);
+			}
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,201 @@
+#pragma once
+#ifndef __HANDOFF_H__
+#define __HANDOFF_H__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+* Physics on its own thread, handing completed states to the render thread
+* - triple_buffer_t: three slots; the writer fills its back slot and exchanges it with the
+*   middle one, the reader exchanges its front slot with the middle one when a newer state is
+*   there; one atomic exchange per side, so neither ever waits for the other; states published
+*   between two reads are skipped, never torn
+* - render_state_t: the instance data of a state and the centers it moves from; the render
+*   thread interpolates between them by its own clock, at most one advance behind the physics
+* - physics_thread_t: runs the fixed_stepper_t against a steady clock and publishes after every
+*   advance that stepped; the render thread only reads the triple buffer
+* - edits of the viewer (keys, snapshots, picking) take the mutex, which is held around an
+*   advance and never by a frame; an edit that replaces the bodies sets b_changed, and the
+*   physics thread republishes without interpolating across it
+* - the render thread interpolates serially: waiting in parallel_for, it could run a chunk of
+*   the physics step queued on the same deque
+*/
+static const float	HANDOFF_ADAPTIVE_DT = 1.0f / 60.0f;	// adaptive mode: time advanced at once by the physics thread
+static const float	HANDOFF_PAUSE_POLL = 1.0f / 60.0f;		// sleep of the physics thread while paused
+static const uint	TRIPLE_FRESH = 4;						// middle slot published and not read yet
+static const uint	TRIPLE_INDEX = 3;
+
+// seconds of a steady clock shared by both threads
+inline double handoff_clock()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// single writer, single reader
+template <typename T>
+struct triple_buffer_t
+{
+	T					slots[3];
+	std::atomic<uint>	middle{ 1 };	// slot index, with TRIPLE_FRESH once published
+	uint				back = 0;		// owned by the writer
+	uint				front = 2;		// owned by the reader
+
+	// public functions
+	T&		write_slot() { return slots[back]; }
+	void	publish() { back = middle.exchange(back | TRIPLE_FRESH, std::memory_order_acq_rel) & TRIPLE_INDEX; }
+	bool	acquire();				// takes the newest published slot; false when there is none since the last call
+	T&		read_slot() { return slots[front]; }
+};
+
+template <typename T>
+inline bool triple_buffer_t<T>::acquire()
+{
+	if (!(middle.load(std::memory_order_relaxed) & TRIPLE_FRESH)) return false;
+	front = middle.exchange(front, std::memory_order_acq_rel) & TRIPLE_INDEX;
+	return true;
+}
+
+struct render_state_t
+{
+	std::vector<render_body_t>	bodies;		// instance data; the reader writes the interpolated centers
+	float_array	px0, py0, pz0;				// centers of the previous state
+	float_array	px1, py1, pz1;				// centers of this state
+	double		time = 0.0;					// simulated time
+	double		published = 0.0;			// handoff_clock() at the publish
+	double		span = 0.0;					// simulated time from the previous state; 0: no interpolation
+	uint64_t	edits = ~uint64_t(0);		// edit count the instance data was copied at
+};
+
+struct physics_thread_t
+{
+	triple_buffer_t<render_state_t>	states;
+	std::mutex			mutex;				// held around an advance and by edits
+	std::atomic<bool>	b_paused{ false };
+	std::atomic<bool>	b_stop{ false };
+	bool				b_changed = true;	// under mutex: the bodies were edited; republish without interpolation
+	std::thread			worker;
+
+	// owned by the worker
+	fixed_stepper_t*	stepper = nullptr;
+	physics_t*			physics = nullptr;
+	body_store_t*		bodies = nullptr;
+	const std::vector<wall_t>*	walls = nullptr;
+	float_array			last_px, last_py, last_pz;	// centers of the last published state
+	double				last_time = 0.0;
+	uint64_t			edits = 0;
+
+	physics_thread_t() = default;
+	physics_thread_t( const physics_thread_t& ) = delete;
+	physics_thread_t& operator=( const physics_thread_t& ) = delete;
+	~physics_thread_t() { stop(); }
+
+	// public functions
+	void	start( fixed_stepper_t& s, physics_t& p, body_store_t& b, const std::vector<wall_t>& w );
+	void	stop();
+	bool	is_running() const { return worker.joinable(); }
+	std::unique_lock<std::mutex>	edit() { return std::unique_lock<std::mutex>(mutex); }	// holds the physics between two advances
+	const std::vector<render_body_t>&	acquire( double now );	// newest state interpolated to now; never blocks
+
+	// internal functions
+	void	run();
+	void	publish( double now );
+};
+
+inline void physics_thread_t::start(fixed_stepper_t& s, physics_t& p, body_store_t& b, const std::vector<wall_t>& w)
+{
+	stop();
+	stepper = &s;
+	physics = &p;
+	bodies = &b;
+	walls = &w;
+	b_stop = false;
+	b_changed = true;
+	publish(handoff_clock());	// a state to draw before the first advance
+	worker = std::thread([this]() { run(); });
+}
+
+inline void physics_thread_t::stop()
+{
+	if (!worker.joinable()) return;
+	b_stop = true;
+	worker.join();
+}
+
+inline void physics_thread_t::run()
+{
+	double last = handoff_clock();
+	while (!b_stop)
+	{
+		double now = handoff_clock(), wait;
+		float dt = float(now - last);
+		last = now;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			bool b_stepped = false;
+			if (!b_paused)
+			{
+				stepper->advance(dt, *physics, *bodies, *walls);
+				b_stepped = stepper->substeps > 0;
+			}
+			if (b_stepped || b_changed) publish(handoff_clock());
+
+			// sleep until the next step is due
+			if (b_paused) wait = HANDOFF_PAUSE_POLL;
+			else if (stepper->b_adaptive) wait = HANDOFF_ADAPTIVE_DT - (handoff_clock() - now);
+			else wait = (stepper->step - stepper->accumulator) - (handoff_clock() - now);
+		}
+		if (wait > 0.0) std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+	}
+}
+
+// under mutex, or before the worker starts
+inline void physics_thread_t::publish(double now)
+{
+	render_state_t& s = states.write_slot();
+	const body_store_t& b = *bodies;
+	size_t n = b.size();
+	bool b_edit = b_changed || last_px.size() != n;
+	if (b_edit)
+	{
+		edits++;
+		last_px.resize(n); last_py.resize(n); last_pz.resize(n);
+		for (size_t i = 0; i < n; i++) { last_px[i] = float(b.px[i]); last_py[i] = float(b.py[i]); last_pz[i] = float(b.pz[i]); }
+		last_time = stepper->time;
+		b_changed = false;
+	}
+	if (s.edits != edits) { s.bodies = b.render; s.edits = edits; }
+
+	// the previous state moves to px0 and the current one is written to px1 and kept in last
+	s.px0.swap(last_px); s.py0.swap(last_py); s.pz0.swap(last_pz);
+	for (float_array* a : { &s.px1, &s.py1, &s.pz1, &last_px, &last_py, &last_pz }) a->resize(n);
+	parallel_for(n, BODY_GRAIN, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			last_px[i] = s.px1[i] = float(b.px[i]);
+			last_py[i] = s.py1[i] = float(b.py[i]);
+			last_pz[i] = s.pz1[i] = float(b.pz[i]);
+		}
+	});
+	s.span = stepper->time - last_time;
+	s.time = last_time = stepper->time;
+	s.published = now;
+	states.publish();
+}
+
+inline const std::vector<render_body_t>& physics_thread_t::acquire(double now)
+{
+	states.acquire();
+	render_state_t& s = states.read_slot();
+	float a = s.span > 0.0 ? float(std::min(std::max((now - s.published) / s.span, 0.0), 1.0)) : 1.0f, c = 1.0f - a;
+	for (size_t i = 0, n = s.bodies.size(); i < n; i++)
+		s.bodies[i].center_radius = vec4(s.px0[i] * c + s.px1[i] * a, s.py0[i] * c + s.py1[i] * a, s.pz0[i] * c + s.pz1[i] * a, s.bodies[i].center_radius.w);
+	return s.bodies;
+}
+
+#endif
@@ -0,0 +1,361 @@
+#include "fpmode.h"		// no fma contraction, before any code
+#include "cgmath.h"		// slee's simple math library
+#include "wall.h"		// wall class definition
+#include "random.h"		// seeded random number generator
+#include "sphere.h"		// sphere class definition
+#include "body.h"		// structure-of-arrays body store
+#include "spawn.h"		// non-overlapping sphere spawner
+#include "simd.h"		// SSE/AVX2/AVX-512 wrapper
+#include "narrowphase.h"	// batched narrowphase and impulse
+#include "container.h"	// convex container walls
+#include "grid.h"		// uniform grid broadphase
+#include "sap.h"		// sweep-and-prune broadphase
+#include "aabbtree.h"	// dynamic AABB tree broadphase
+#include "paircache.h"	// persistent contact-pair cache
+#include "parallel.h"	// worker threads
+#include "solver.h"		// parallel contact solver
+#include "ccd.h"		// continuous collision detection
+#include "event.h"		// event-driven hard-sphere engine
+#include "octree.h"		// Morton-ordered octree
+#include "gravity.h"	// Barnes-Hut gravity
+#include "integrator.h"	// integrator policies
+#include "trajectory.h"	// compressed trajectory recorder
+#include "physics.h"	// per-step simulation driver
+#include "stepper.h"	// fixed-timestep accumulator
+#include "snapshot.h"	// binary snapshot of the state
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+//*************************************
+// headless simulation: no window, no OpenGL
+// - spawns the spheres as the viewer does (or loads a snapshot), runs a fixed number of steps
+//   and reports steps per second, collisions (overlapping pairs) and ccd impacts per step and the final state
+// - with --adaptive, each of the steps is a frame split into substeps by the stepper (see stepper.h)
+
+struct stopwatch_t
+{
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	double	ms() const { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count(); }
+};
+
+static const uint GRAVITY_ENERGY_MAX_BODIES = 20000;	// the gravity flow energy is an O(N^2) sum
+static const uint CHECK_THREADS[] = { 1, 2, 4 };		// thread counts compared by --check-threads
+
+struct options_t
+{
+	uint64_t	steps = 1000;
+	float		dt = 0.0f;				// 0: the viewer's fixed step, or a 60 Hz frame with b_adaptive
+	bool		b_adaptive = false;		// steps are frames of CFL-bounded substeps
+	float		cfl = CFL_LIMIT;
+	vec3		box = vec3(0.0f);		// 0: the Cornell box
+	bool		b_fit_radii = true;
+	const char*	dump_path = nullptr;	// final state, one body per line
+	const char*	load_path = nullptr;	// start from this snapshot instead of spawning
+	const char*	save_path = nullptr;	// snapshot of the final state
+	const char*	checkpoint_path = nullptr;	// snapshot every checkpoint_steps, written in the background
+	uint64_t	checkpoint_steps = 0;
+	const char*	record_path = nullptr;	// trajectory of every step (see trajectory.h)
+	bool		b_check_threads = false;	// compare the final hashes at CHECK_THREADS
+	spawn_params_t	spawn = { 1000 };
+};
+
+struct summary_t
+{
+	double	energy = 0.0;			// kinetic energy, m = 1 / inv_mass
+	vec3	momentum = vec3(0.0f);
+	uint	outside = 0;			// bodies not inside the box interior
+};
+
+summary_t summarize(const body_store_t& b, vec3 lo, vec3 hi)
+{
+	summary_t s;
+	double px = 0, py = 0, pz = 0;
+	for (uint i = 0, n = uint(b.size()); i < n; i++)
+	{
+		if (b.inv_mass[i] > 0)
+		{
+			double m = 1.0 / b.inv_mass[i];
+			s.energy += 0.5 * m * (double(b.vx[i]) * b.vx[i] + double(b.vy[i]) * b.vy[i] + double(b.vz[i]) * b.vz[i]);
+			px += m * b.vx[i]; py += m * b.vy[i]; pz += m * b.vz[i];
+		}
+		vec3 c = b.center(i);
+		if (c.x < lo.x || c.y < lo.y || c.z < lo.z || c.x > hi.x || c.y > hi.y || c.z > hi.z) s.outside++;
+	}
+	s.momentum = vec3(float(px), float(py), float(pz));
+	return s;
+}
+
+bool dump_state(const char* path, const body_store_t& b)
+{
+	FILE* fp = fopen(path, "w");
+	if (!fp) { printf("Failed to open %s\n", path); return false; }
+	fprintf(fp, "# x y z vx vy vz radius\n");
+	for (uint i = 0, n = uint(b.size()); i < n; i++)
+		fprintf(fp, "%.9g %.9g %.9g %.9g %.9g %.9g %.9g\n", b.px[i], b.py[i], b.pz[i], b.vx[i], b.vy[i], b.vz[i], b.radius[i]);
+	fclose(fp);
+	return true;
+}
+
+void print_usage(const char* name)
+{
+	printf("usage: %s [--steps N] [--spheres N] [--seed N] [--dt SEC] [--box W H D]\n", name);
+	printf("       [--spawn poisson|lattice] [--radius MIN MAX] [--power EXP] [--speed MAX] [--broadphase NAME]\n");
+	printf("       [--serial] [--threads N] [--ccd] [--no-pair-cache] [--event] [--gravity [THETA]]\n");
+	printf("       [--integrator symplectic-euler|verlet|rk4]\n");
+	printf("       [--adaptive [CFL]] [--deterministic] [--hash-log FILE] [--dump FILE]\n");
+	printf("       [--load FILE] [--save FILE] [--checkpoint STEPS FILE] [--record FILE] [--check-threads]\n");
+}
+
+// deterministic runs of the same steps at each of CHECK_THREADS; true when the state hashes match
+bool check_threads(const options_t& o, const physics_t& config, const body_store_t& initial, const std::vector<wall_t>& walls)
+{
+	uint64_t first = 0;
+	bool b_match = true;
+	for (uint threads : CHECK_THREADS)
+	{
+		get_job_system().start(threads);
+		physics_t physics = config;
+		physics.b_deterministic = true;
+		body_store_t bodies = initial;
+		stopwatch_t t;
+		for (uint64_t k = 0; k < o.steps; k++) physics.step(o.dt, bodies, walls);
+		uint64_t hash = state_hash(bodies);
+		if (threads == CHECK_THREADS[0]) first = hash;
+		b_match = b_match && hash == first;
+		printf("threads %-5u state hash %016llx, %.1f ms%s\n", threads, (unsigned long long) hash, t.ms(), hash == first ? "" : "  MISMATCH");
+	}
+	printf("thread check  %s\n", b_match ? "ok" : "FAILED");
+	return b_match;
+}
+
+// --steps N: number of physics steps
+// --spheres N, --seed N, --spawn, --radius, --power: as in the viewer
+// --speed MAX: velocity components in [-MAX, MAX) (spawn_params_t::max_speed)
+// --dt SEC: physics step; the viewer's fixed step by default
+// --box W H D: axis-aligned box [0,W] x [0,H] x [-D,0] instead of the Cornell box
+// --broadphase all-pairs|grid|sweep-and-prune|aabb-tree
+// --serial, --ccd, --no-pair-cache, --event, --gravity [THETA]: physics options
+// --threads N: threads of the job system (hardware concurrency by default)
+// --integrator NAME: integrator policy of the gravity kicks (see integrator.h)
+// --adaptive [CFL]: every step is a frame of --dt (1/60 s by default) split into the fewest
+//   substeps that keep |v|*dt/r under CFL (CFL_LIMIT, times CCD_STEP_RATIO with ccd, by default)
+// --deterministic, --hash-log FILE: state hash per step as in the viewer
+// --dump FILE: write the final centers, velocities and radii
+// --load FILE: start from a snapshot (the spawn and box options are ignored)
+// --save FILE: snapshot of the final state
+// --checkpoint STEPS FILE: snapshot every STEPS steps, written while stepping goes on
+// --record FILE: compressed trajectory of the initial state and every step
+// --check-threads: run the steps deterministically at 1, 2 and 4 threads instead, and fail
+//   (exit code 1) unless the final state hashes are equal
+bool parse_args(int argc, char* argv[], options_t& o, physics_t& physics)
+{
+	for (int k = 1; k < argc; k++)
+	{
+		if (strcmp(argv[k], "--steps") == 0 && k + 1 < argc) o.steps = strtoull(argv[++k], nullptr, 10);
+		else if (strcmp(argv[k], "--spheres") == 0 && k + 1 < argc) o.spawn.count = uint(strtoul(argv[++k], nullptr, 10));
+		else if (strcmp(argv[k], "--seed") == 0 && k + 1 < argc) o.spawn.seed = strtoull(argv[++k], nullptr, 10);
+		else if (strcmp(argv[k], "--dt") == 0 && k + 1 < argc) o.dt = float(atof(argv[++k]));
+		else if (strcmp(argv[k], "--box") == 0 && k + 3 < argc)
+		{
+			float w = float(atof(argv[++k])), h = float(atof(argv[++k]));
+			o.box = vec3(w, h, float(atof(argv[++k])));
+		}
+		else if (strcmp(argv[k], "--spawn") == 0 && k + 1 < argc) o.spawn.mode = strcmp(argv[++k], SPAWN_NAME[SPAWN_LATTICE]) == 0 ? SPAWN_LATTICE : SPAWN_POISSON;
+		else if (strcmp(argv[k], "--radius") == 0 && k + 2 < argc)
+		{
+			o.spawn.min_radius = float(atof(argv[++k]));
+			o.spawn.max_radius = std::max(float(atof(argv[++k])), o.spawn.min_radius);
+			o.b_fit_radii = false;
+		}
+		else if (strcmp(argv[k], "--power") == 0 && k + 1 < argc) { o.spawn.dist = RADIUS_POWER; o.spawn.exponent = float(atof(argv[++k])); }
+		else if (strcmp(argv[k], "--speed") == 0 && k + 1 < argc) o.spawn.max_speed = float(atof(argv[++k]));
+		else if (strcmp(argv[k], "--broadphase") == 0 && k + 1 < argc)
+		{
+			int m = 0;
+			for (k++; m < BROADPHASE_COUNT && strcmp(argv[k], BROADPHASE_NAME[m]) != 0; m++);
+			if (m == BROADPHASE_COUNT) { printf("unknown broadphase %s\n", argv[k]); return false; }
+			physics.broadphase = broadphase_mode(m);
+		}
+		else if (strcmp(argv[k], "--serial") == 0) physics.b_parallel = false;
+		else if (strcmp(argv[k], "--threads") == 0 && k + 1 < argc) get_job_system().start(uint(strtoul(argv[++k], nullptr, 10)));
+		else if (strcmp(argv[k], "--ccd") == 0) physics.b_ccd = true;
+		else if (strcmp(argv[k], "--no-pair-cache") == 0) physics.b_pair_cache = false;
+		else if (strcmp(argv[k], "--event") == 0) physics.b_event = true;
+		else if (strcmp(argv[k], "--gravity") == 0)
+		{
+			physics.b_gravity = true;
+			if (k + 1 < argc && argv[k + 1][0] != '-') physics.gravity.theta = float(atof(argv[++k]));
+		}
+		else if (strcmp(argv[k], "--adaptive") == 0)
+		{
+			o.b_adaptive = true;
+			if (k + 1 < argc && argv[k + 1][0] != '-') o.cfl = float(atof(argv[++k]));
+			else o.cfl = 0.0f;
+		}
+		else if (strcmp(argv[k], "--integrator") == 0 && k + 1 < argc)
+		{
+			int m = 0;
+			for (k++; m < INTEGRATOR_COUNT && strcmp(argv[k], INTEGRATOR_NAME[m]) != 0; m++);
+			if (m == INTEGRATOR_COUNT) { printf("unknown integrator %s\n", argv[k]); return false; }
+			physics.integrator = integrator_mode(m);
+		}
+		else if (strcmp(argv[k], "--deterministic") == 0) physics.b_deterministic = true;
+		else if (strcmp(argv[k], "--hash-log") == 0 && k + 1 < argc)
+		{
+			if (!(physics.hash_log = fopen(argv[++k], "w"))) { printf("Failed to open %s\n", argv[k]); return false; }
+			physics.b_deterministic = true;
+		}
+		else if (strcmp(argv[k], "--dump") == 0 && k + 1 < argc) o.dump_path = argv[++k];
+		else if (strcmp(argv[k], "--load") == 0 && k + 1 < argc) o.load_path = argv[++k];
+		else if (strcmp(argv[k], "--save") == 0 && k + 1 < argc) o.save_path = argv[++k];
+		else if (strcmp(argv[k], "--checkpoint") == 0 && k + 2 < argc)
+		{
+			o.checkpoint_steps = strtoull(argv[++k], nullptr, 10);
+			o.checkpoint_path = argv[++k];
+		}
+		else if (strcmp(argv[k], "--record") == 0 && k + 1 < argc) o.record_path = argv[++k];
+		else if (strcmp(argv[k], "--check-threads") == 0) o.b_check_threads = true;
+		else { print_usage(argv[0]); return false; }
+	}
+	return true;
+}
+
+int main( int argc, char* argv[] )
+{
+	options_t o;
+	physics_t physics;
+	if (!parse_args(argc, argv, o, physics)) return 1;
+	if (o.dt <= 0.0f) o.dt = o.b_adaptive ? 1.0f / 60.0f : (physics.b_ccd ? CCD_STEP_RATIO : 1.0f) / PHYSICS_HZ;
+	if (o.b_adaptive && o.record_path) { printf("--record needs a fixed step\n"); return 1; }
+	if (o.b_check_threads && (o.b_adaptive || o.record_path || o.checkpoint_steps)) { printf("--check-threads runs plain fixed steps\n"); return 1; }
+	fixed_stepper_t stepper;
+	stepper.b_adaptive = o.b_adaptive;
+	stepper.cfl = o.cfl > 0.0f ? o.cfl : (physics.b_ccd ? CCD_STEP_RATIO : 1.0f) * CFL_LIMIT;
+
+	std::vector<wall_t> walls = o.box.x > 0 && o.box.y > 0 && o.box.z > 0 ? create_box(o.box) : create_cornellbox();
+	vec3 lo, hi;
+	box_interior(walls, lo, hi);
+
+	body_store_t bodies;
+	snapshot_info_t info;
+	info.seed = o.spawn.seed;
+	uint placed;
+	stopwatch_t t;
+	if (o.load_path)
+	{
+		if (!load_snapshot(o.load_path, bodies, walls, info)) return 1;
+		physics.step_count = info.step_count;
+		if (walls.size() == 6) box_interior(walls, lo, hi);
+		else lo = vec3(-FLT_MAX), hi = vec3(FLT_MAX);
+		placed = uint(bodies.size());
+		printf("%u spheres, %zu walls from %s (step %llu, t = %.3f s), %.1f ms\n", placed, walls.size(), o.load_path,
+			(unsigned long long) info.step_count, info.time, t.ms());
+	}
+	else
+	{
+		o.spawn.lo = lo;
+		o.spawn.hi = hi;
+		if (o.b_fit_radii) fit_radii(o.spawn);
+		info.rng = rng_t(o.spawn.seed);
+		placed = spawn_spheres(bodies, o.spawn, info.rng);
+		if (!placed) { printf("no sphere fits the box\n"); return 1; }
+		if (physics.b_gravity) set_density_masses(bodies);
+		printf("%u spheres (%s, radius %.3g ~ %.3g) in %.1f x %.1f x %.1f, seed %llu, %.1f ms\n", placed, SPAWN_NAME[o.spawn.mode],
+			o.spawn.min_radius, o.spawn.max_radius, hi.x - lo.x, hi.y - lo.y, hi.z - lo.z, (unsigned long long) o.spawn.seed, t.ms());
+	}
+	printf("%llu %s of %.5g s, %s broadphase, %s, ccd %s, pair cache %s%s%s%s\n", (unsigned long long) o.steps, o.b_adaptive ? "adaptive frames" : "steps", o.dt,
+		BROADPHASE_NAME[physics.broadphase], physics.b_parallel ? "parallel" : "serial", physics.b_ccd ? "on" : "off",
+		physics.b_pair_cache ? "on" : "off", physics.b_gravity ? ", gravity, " : "", physics.b_gravity ? INTEGRATOR_NAME[physics.integrator] : "", physics.b_event ? ", event-driven" : "");
+	if (physics.b_parallel) printf("%u threads\n", uint(get_job_system().size()));
+	if (o.b_adaptive) printf("cfl %.3g, at most %d substeps / frame\n", stepper.cfl, stepper.max_substeps);
+	if (o.b_check_threads) return check_threads(o, physics, bodies, walls) ? 0 : 1;
+
+	summary_t s0 = summarize(bodies, lo, hi);
+	bool b_gravity_energy = physics.b_gravity && !physics.b_event && placed <= GRAVITY_ENERGY_MAX_BODIES;
+	double k0 = 0.0, e0 = b_gravity_energy ? physics.gravity.energy(bodies, &k0) : 0.0;
+	size_t collisions = 0, max_collisions = 0, tested = 0, impacts = 0;
+	snapshot_writer_t writer;
+	uint checkpoints = 0, skipped = 0;
+	double pause_ms = 0.0;		// longest stall of stepping by a checkpoint
+	trajectory_writer_t recorder;
+	if (o.record_path)
+	{
+		bool b_box = lo.x > -FLT_MAX;
+		if (!recorder.open(o.record_path, bodies, b_box ? lo : vec3(0.0f), b_box ? hi : vec3(0.0f), o.dt, info.time)) return 1;
+		recorder.push(bodies);
+		physics.recorder = &recorder;
+	}
+	t = stopwatch_t();
+	for (uint64_t k = 0; k < o.steps; k++)
+	{
+		float h = o.dt;
+		int n = o.b_adaptive ? stepper.plan_substeps(o.dt, bodies, physics.b_parallel, h) : 1;
+		for (int s = 0; s < n; s++)
+		{
+			physics.step(h, bodies, walls);
+			collisions += physics.contacts;
+			tested += physics.tested;
+			max_collisions = std::max(max_collisions, physics.contacts);
+			if (physics.b_ccd && !physics.b_event) impacts += physics.ccd.impacts;
+		}
+		info.time += double(h) * n;
+
+		if (o.checkpoint_steps && (k + 1) % o.checkpoint_steps == 0)
+		{
+			stopwatch_t p;
+			info.step_count = physics.step_count;
+			if (writer.save(o.checkpoint_path, bodies, walls, info)) checkpoints++;
+			else skipped++;
+			pause_ms = std::max(pause_ms, p.ms());
+		}
+	}
+	double ms = t.ms();
+	writer.wait();
+	recorder.close();
+	physics.recorder = nullptr;
+	summary_t s1 = summarize(bodies, lo, hi);
+
+	double sec = ms / 1000.0, steps = double(std::max(o.b_adaptive ? stepper.total_substeps : o.steps, uint64_t(1)));
+	printf("\n");
+	printf("time          %.3f s (%.4f ms/step)\n", sec, ms / steps);
+	printf("steps/s       %.1f\n", steps / std::max(sec, 1e-9));
+	printf("body-steps/s  %.4g\n", double(placed) * steps / std::max(sec, 1e-9));
+	if (o.b_adaptive)
+		printf("substeps      %.2f / frame (max %d), last max |v|/r %.3g /s, %.3f s of %.3f s dropped\n", double(stepper.total_substeps) / std::max(double(stepper.frames), 1.0),
+			stepper.peak_substeps, stepper.speed_ratio, stepper.dropped_time, o.steps * double(o.dt));
+	printf("collisions    %.2f / step (max %zu, total %zu), %.2f pairs tested / step\n", collisions / steps, max_collisions, collisions, tested / steps);
+	if (physics.b_ccd && !physics.b_event)
+		printf("ccd impacts   %.2f / step (total %zu)\n", impacts / steps, impacts);
+	if (physics.b_pair_cache && !physics.b_event)
+		printf("pair cache    %zu rebuilds, %zu reuses, %zu bypasses\n", physics.pair_cache.rebuilds, physics.pair_cache.reuses, physics.pair_cache.bypasses);
+	if (o.checkpoint_steps)
+		printf("checkpoints   %u written, %u skipped (previous still writing), longest pause %.2f ms\n", checkpoints, skipped, pause_ms);
+	if (o.record_path)
+		printf("trajectory    %llu frames, %.2f MB, %.3f bytes / body / frame%s\n", (unsigned long long) recorder.frame_count(), recorder.bytes / 1048576.0,
+			double(recorder.bytes) / std::max(double(placed) * recorder.frame_count(), 1.0), recorder.failed ? " (write failed)" : "");
+	printf("\n");
+	printf("energy        %.6g -> %.6g (%+.3g%%)\n", s0.energy, s1.energy, s0.energy > 0 ? 100.0 * (s1.energy - s0.energy) / s0.energy : 0.0);
+	if (b_gravity_energy)
+	{
+		double e1 = physics.gravity.energy(bodies);
+		printf("gravity flow  %.6g -> %.6g (%+.3g%% of the initial kinetic part)\n", e0, e1, 100.0 * (e1 - e0) / std::max(k0, 1e-30));
+	}
+	printf("momentum      (%.4g, %.4g, %.4g)\n", s1.momentum.x, s1.momentum.y, s1.momentum.z);
+	printf("outside       %u\n", s1.outside);
+	printf("state hash    %016llx\n", (unsigned long long) state_hash(bodies));
+
+	if (physics.hash_log) fclose(physics.hash_log);
+	if (o.dump_path && !dump_state(o.dump_path, bodies)) return 1;
+	if (o.save_path)
+	{
+		info.step_count = physics.step_count;
+		writer.save(o.save_path, bodies, walls, info);
+		writer.wait();
+		if (writer.failed) return 1;
+	}
+	return 0;
+}
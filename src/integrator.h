@@ -0,0 +1,149 @@
+#pragma once
+#ifndef __INTEGRATOR_H__
+#define __INTEGRATOR_H__
+
+#include <algorithm>
+#include <vector>
+
+/*
+* Integrator policies of the time-stepping loop
+* - the step moves bodies in a straight line (integrate, or ccd.advance) after the walls and
+*   contacts; a policy places velocity kicks from a force field around that drift:
+*   begin() before the walls, end() after the drift, so contacts and CCD stay unchanged
+* - a force provides accelerations(bodies), filling ax, ay, az at the current centers, and the
+*   factor G they are scaled by (see gravity.h)
+* - symplectic_euler_t: kick, drift (one field evaluation per step; the previous behavior)
+* - velocity_verlet_t: half kick, drift, half kick at the new centers; the field of the end
+*   kick is kept for the next begin while the centers are unchanged (one evaluation per step);
+*   time-reversible and symplectic, so the energy error stays bounded at much larger steps
+* - rk4_t: classic Runge-Kutta on x' = VELOCITY_SCALE*v, v' = G*a(x) (four evaluations per step);
+*   its displacement equals a straight drift at v0 + G*h*(a1+a2+a3)/6, which begin() applies, and
+*   end() adds the rest, G*h*(a2+a3+a4)/6; exact RK4 when nothing collides
+* - physics_t::step switches on the mode once per step; the per-body loops are inlined
+*   templates of the policy
+*/
+static const size_t INTEGRATOR_GRAIN = 4096;	// min bodies per chunk
+
+enum integrator_mode
+{
+	INTEGRATOR_SYMPLECTIC_EULER = 0,
+	INTEGRATOR_VELOCITY_VERLET,
+	INTEGRATOR_RK4,
+	INTEGRATOR_COUNT
+};
+
+static const char* INTEGRATOR_NAME[INTEGRATOR_COUNT] = { "symplectic-euler", "verlet", "rk4" };
+
+// state kept across steps by the policies
+struct integrator_state_t
+{
+	bool		b_field = false;		// the force's ax, ay, az are at the current centers
+	real_array	x, y, z;				// rk4 stage centers
+	real_array	vx, vy, vz;				// rk4 stage velocities
+	float_array	kx, ky, kz;				// rk4 sum of the stage accelerations
+	float_array	ex, ey, ez;				// rk4 kick of end()
+
+	void	clear() { b_field = false; }
+};
+
+// v += a * h over all bodies
+template <typename Real>
+inline void kick(basic_body_store_t<Real>& b, const float* ax, const float* ay, const float* az, float h, size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		b.vx[i] += ax[i] * h;
+		b.vy[i] += ay[i] * h;
+		b.vz[i] += az[i] * h;
+	}
+}
+
+struct symplectic_euler_t
+{
+	template <typename Force>
+	static void begin( integrator_state_t& s, Force& force, body_store_t& b, float dt )
+	{
+		float h = std::min(dt, MAX_DT) * force.G;
+		force.accelerations(b);
+		parallel_for(b.size(), INTEGRATOR_GRAIN, [&](size_t i0, size_t i1) { kick(b, force.ax.data(), force.ay.data(), force.az.data(), h, i0, i1); });
+		s.b_field = false;
+	}
+	template <typename Force>
+	static void end( integrator_state_t&, Force&, body_store_t&, float ) {}
+};
+
+struct velocity_verlet_t
+{
+	template <typename Force>
+	static void begin( integrator_state_t& s, Force& force, body_store_t& b, float dt )
+	{
+		float h = 0.5f * std::min(dt, MAX_DT) * force.G;
+		if (!s.b_field || force.ax.size() != b.size()) force.accelerations(b);
+		parallel_for(b.size(), INTEGRATOR_GRAIN, [&](size_t i0, size_t i1) { kick(b, force.ax.data(), force.ay.data(), force.az.data(), h, i0, i1); });
+		s.b_field = false;
+	}
+	template <typename Force>
+	static void end( integrator_state_t& s, Force& force, body_store_t& b, float dt )
+	{
+		float h = 0.5f * std::min(dt, MAX_DT) * force.G;
+		force.accelerations(b);
+		parallel_for(b.size(), INTEGRATOR_GRAIN, [&](size_t i0, size_t i1) { kick(b, force.ax.data(), force.ay.data(), force.az.data(), h, i0, i1); });
+		s.b_field = true;
+	}
+};
+
+struct rk4_t
+{
+	template <typename Force>
+	static void begin( integrator_state_t& s, Force& force, body_store_t& b, float dt )
+	{
+		size_t n = b.size();
+		float h = std::min(dt, MAX_DT), g = h * force.G;
+		for (real_array* a : { &s.x, &s.y, &s.z, &s.vx, &s.vy, &s.vz }) a->resize(n);
+		for (float_array* a : { &s.kx, &s.ky, &s.kz, &s.ex, &s.ey, &s.ez }) a->resize(n);
+
+		// stage k: x = x0 + VELOCITY_SCALE*c[k]*h * v(stage k-1), v = v0 + G*c[k]*h * a(stage k-1)
+		static const float c[4] = { 0.0f, 0.5f, 0.5f, 1.0f };
+		for (int k = 0; k < 4; k++)
+		{
+			if (k > 0)
+			{
+				float dx = VELOCITY_SCALE * c[k] * h, dv = c[k] * g;
+				parallel_for(n, INTEGRATOR_GRAIN, [&](size_t i0, size_t i1)
+				{
+					for (size_t i = i0; i < i1; i++)
+					{
+						s.x[i] = b.px[i] + s.vx[i] * dx; s.vx[i] = b.vx[i] + force.ax[i] * dv;
+						s.y[i] = b.py[i] + s.vy[i] * dx; s.vy[i] = b.vy[i] + force.ay[i] * dv;
+						s.z[i] = b.pz[i] + s.vz[i] * dx; s.vz[i] = b.vz[i] + force.az[i] * dv;
+					}
+				});
+				b.px.swap(s.x); b.py.swap(s.y); b.pz.swap(s.z);
+			}
+			else { s.vx = b.vx; s.vy = b.vy; s.vz = b.vz; }
+			force.accelerations(b);
+			if (k > 0) { b.px.swap(s.x); b.py.swap(s.y); b.pz.swap(s.z); }
+
+			// a1+a2+a3 for the drift, a2+a3+a4 for the end kick
+			parallel_for(n, INTEGRATOR_GRAIN, [&](size_t i0, size_t i1)
+			{
+				for (size_t i = i0; i < i1; i++)
+				{
+					if (k == 0) { s.kx[i] = force.ax[i]; s.ky[i] = force.ay[i]; s.kz[i] = force.az[i]; s.ex[i] = s.ey[i] = s.ez[i] = 0.0f; continue; }
+					if (k < 3) { s.kx[i] += force.ax[i]; s.ky[i] += force.ay[i]; s.kz[i] += force.az[i]; }
+					s.ex[i] += force.ax[i]; s.ey[i] += force.ay[i]; s.ez[i] += force.az[i];
+				}
+			});
+		}
+		parallel_for(n, INTEGRATOR_GRAIN, [&](size_t i0, size_t i1) { kick(b, s.kx.data(), s.ky.data(), s.kz.data(), g / 6.0f, i0, i1); });
+		s.b_field = false;
+	}
+	template <typename Force>
+	static void end( integrator_state_t& s, Force& force, body_store_t& b, float dt )
+	{
+		float g = std::min(dt, MAX_DT) * force.G / 6.0f;
+		parallel_for(b.size(), INTEGRATOR_GRAIN, [&](size_t i0, size_t i1) { kick(b, s.ex.data(), s.ey.data(), s.ez.data(), g, i0, i1); });
+	}
+};
+
+#endif
@@ -1,7 +1,31 @@
+#include "fpmode.h"		// no fma contraction, before any code
 #include "cgmath.h"		// slee's simple math library
 #include "cgut.h"		// slee's OpenGL utility
 #include "wall.h"		// wall class definition
+#include "random.h"		// seeded random number generator
 #include "sphere.h"		// sphere class definition
+#include "body.h"		// structure-of-arrays body store
+#include "spawn.h"		// non-overlapping sphere spawner
+#include "simd.h"		// SSE/AVX2/AVX-512 wrapper
+#include "narrowphase.h"	// batched narrowphase and impulse
+#include "container.h"	// convex container walls
+#include "grid.h"		// uniform grid broadphase
+#include "sap.h"		// sweep-and-prune broadphase
+#include "aabbtree.h"	// dynamic AABB tree broadphase
+#include "paircache.h"	// persistent contact-pair cache
+#include "parallel.h"	// worker threads
+#include "solver.h"		// parallel contact solver
+#include "ccd.h"		// continuous collision detection
+#include "event.h"		// event-driven hard-sphere engine
+#include "octree.h"		// Morton-ordered octree
+#include "gravity.h"	// Barnes-Hut gravity
+#include "integrator.h"	// integrator policies
+#include "trajectory.h"	// compressed trajectory recorder
+#include "physics.h"	// per-step simulation driver
+#include "stepper.h"	// fixed-timestep accumulator
+#include "handoff.h"	// physics thread and triple-buffered states
+#include "snapshot.h"	// binary snapshot of the state
+#include "replay.h"		// trajectory playback
 #include "trackball.h" // virtual trackball
 
 //*************************************
@@ -52,6 +76,7 @@ ivec2		window_size = ivec2(16*60, 9*60);
 // OpenGL objects
 GLuint	program = 0;		// ID holder for GPU program
 GLuint	vertex_array = 0;	// ID holder for vertex array object
+GLuint	instance_buffer = 0;	// ID holder for per-sphere instance data (render_body_t)
 GLuint	SUN = 0;
 GLuint	MERCURY = 0;
 GLuint	VENUS = 0;
@@ -71,16 +96,39 @@ bool	b_index_buffer = true;			// use index buffering?
 #ifndef GL_ES_VERSION_2_0
 bool	b_wireframe = false;
 #endif
-std::vector<sphere_t> spheres;
+body_store_t	bodies;					// simulated spheres
+physics_t	physics;					// broadphase and collision solver
+fixed_stepper_t	stepper;				// fixed physics steps, run by sim
+physics_thread_t	sim;				// steps the bodies on its own thread and hands the states to the renderer
+const std::vector<render_body_t>*	instances = &bodies.render;	// instance data drawn in this frame
 struct { bool add=false, sub=false; operator bool() const { return add||sub; } } b; // flags of keys for smooth changes
 bool	b_is_rotate = true;				// is rotate or stop
 double  simul_time = 0.0f;				// simulation time
 int		color_option = 0;				// color option (0, 1, 2) check circ.frag
-uint	sphere_count = 9;				// 9 planets
+spawn_params_t	spawn = { 9 };			// 9 planets by default (--spheres, --spawn, --radius)
+bool	b_fit_radii = true;				// shrink radii to fit spawn.count unless --radius
+uint64_t	seed = DEFAULT_SEED;		// scene seed (--seed)
+rng_t		rng;						// scene generator after spawning, saved in snapshots
 bool	b_shadow = true;				// Shadow Toggle option
+const char*	snapshot_path = "snapshot.bin";	// F5 saves, F9 loads (--snapshot)
+const char*	load_path = nullptr;		// snapshot loaded at start (--load)
+snapshot_writer_t	snapshot_writer;	// writes snapshots in the background
+const char*	record_path = nullptr;		// trajectory of every step (--record)
+trajectory_writer_t	recorder;			// encodes and writes the trajectory in the background
+const char*	replay_path = nullptr;		// trajectory played back instead of simulating (--replay)
+replay_player_t	player;					// playhead and prefetch of the replay
 
 std::vector<wall_t> cornell_box;
 
+// GPU buffers of a wall; wall_t itself has no GL objects so that the physics builds headless
+struct wall_mesh_t
+{
+	GLuint	vertex_array = 0;
+	GLuint	vertex_buffer = 0;
+	GLuint	index_buffer = 0;
+};
+std::vector<wall_mesh_t> wall_meshes;	// one per cornell_box wall
+
 //*************************************
 // scene objects
 camera		cam = camera(), home = cam;
@@ -103,6 +151,13 @@ void update()
 	else
 		glfwSetTime(simul_time);
 
+	// the newest state of the physics thread, interpolated to now; a replay only reads recorded states
+	static double t0 = 0;
+	float dt = float(t - t0);
+	t0 = t;
+	if (player.is_open()) { player.advance(dt, bodies); instances = &bodies.render; }
+	else { sim.b_paused = !b_is_rotate; instances = &sim.acquire(handoff_clock()); }
+
 	cam.aspect = window_size.x / float(window_size.y);
 	cam.projection_matrix = mat4::perspective(cam.fovy
 		, cam.aspect
@@ -130,13 +185,12 @@ void update()
 
 	// setup spheres properties
 	float sphere_data[4 * 9] = { 0.0 };
-	for (int i = 0; i < 9; i++) {
-		vec3 c = spheres[i].center;
-		float r = spheres[i].radius;
+	for (uint i = 0; i < 9 && i < instances->size(); i++) {
+		const vec4& c = (*instances)[i].center_radius;
 		sphere_data[i * 4] = c.x;
 		sphere_data[i * 4 + 1] = c.y;
 		sphere_data[i * 4 + 2] = c.z;
-		sphere_data[i * 4 + 3] = r;
+		sphere_data[i * 4 + 3] = c.w;
 	}
 	glUniform4fv(glGetUniformLocation(program, "spheres"), 9, sphere_data);
 
@@ -195,34 +249,31 @@ void render()
 	// bind vertex array object
 	glBindVertexArray( vertex_array );
 
-	static double t0 = 0;
-	double dt = t - t0;
-
-	// trigger shader program to process vertex data
-	for( auto& s : spheres )
+	// upload the instance data and draw every sphere in one call
 	{
-		// per-circle update
-		s.update(float(t), float(dt), spheres, cornell_box );
+		glBindBuffer(GL_ARRAY_BUFFER, instance_buffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(render_body_t) * instances->size(), instances->data(), GL_STREAM_DRAW);
 
-		// update per-circle uniforms
 		GLint uloc;
-		uloc = glGetUniformLocation(program, "tex_idx");
-		if (uloc > -1) glUniform1i(uloc, s.tex_idx);
-
-		uloc = glGetUniformLocation( program, "model_matrix" );
-		if(uloc>-1) glUniformMatrix4fv( uloc, 1, GL_TRUE, s.model_matrix );
-
-		// per-circle draw calls
-		glDrawElements(GL_TRIANGLES
+		uloc = glGetUniformLocation(program, "orientation");
+		if (uloc > -1) glUniform4fv(uloc, 1, SPHERE_ORIENTATION);
+		uloc = glGetUniformLocation(program, "b_instanced");
+		if (uloc > -1) glUniform1i(uloc, true);
+		glDrawElementsInstanced(GL_TRIANGLES
 					, (NUM_LONGITUDE * NUM_LATITUDE * 3 * 2)
 					, GL_UNSIGNED_INT
-					, nullptr );
+					, nullptr
+					, GLsizei(instances->size()));
+		if (uloc > -1) glUniform1i(uloc, false);
 	}
 	
-	for (auto& w : cornell_box)
+	for (size_t k = 0; k < cornell_box.size(); k++)
 	{
+		const wall_t& w = cornell_box[k];
+		if (w.vertices.empty()) continue;	// bare plane from a snapshot
+
 		// bind vertex array object
-		glBindVertexArray(w.vertex_array);
+		glBindVertexArray(wall_meshes[k].vertex_array);
 
 		GLint uloc;
 		uloc = glGetUniformLocation(program, "is_wall");
@@ -239,7 +290,6 @@ void render()
 	GLint uloc;
 	uloc = glGetUniformLocation(program, "is_wall");
 	if (uloc > -1) glUniform1i(uloc, false);
-	t0 = float(t);
 
 	// swap front and back buffers, and display to screen
 	glfwSwapBuffers( window );
@@ -263,6 +313,21 @@ void print_help()
 	// printf( "- press 'r' to rotate the sphere\n" );
 	printf( "- press Home to reset camer\n");
 	printf( "- press 'e' to toggle shadows\n");
+	printf( "- press 'b' to switch the collision broadphase\n");
+	printf( "- press 'k' to toggle the persistent pair cache\n");
+	printf( "- press 'p' to toggle the multithreaded solver\n");
+	printf( "- press 'c' to toggle continuous collision detection\n");
+	printf( "- press 'a' to toggle adaptive substepping (CFL bound instead of fixed steps)\n");
+	printf( "- press 'v' to toggle the event-driven engine\n");
+	printf( "- press 'g' to toggle gravity between planets\n");
+	printf( "- press 'n' to switch the gravity integrator\n");
+	printf( "- press F5 to save a snapshot, F9 to load it\n");
+	if (player.is_open())
+	{
+		printf( "- replay: Left/Right to seek 1 s (with Shift: 1 frame)\n");
+		printf( "- replay: ',' to play backward, '.' to play forward, Up/Down to double/halve the rate\n");
+	}
+	printf( "- Alt + left click to pick a sphere\n");
 	printf( "- press Space (or Pause) to pause the simulation");
 
 #ifndef GL_ES_VERSION_2_0
@@ -346,6 +411,113 @@ void update_vertex_buffer( const std::vector<vertex>& vertices, const uint longi
 	if(vertex_array) glDeleteVertexArrays(1,&vertex_array);
 	vertex_array = cg_create_vertex_array( vertex_buffer, index_buffer );
 	if(!vertex_array){ printf("%s(): failed to create vertex aray\n",__func__); return; }
+
+	// per-instance attributes: center_radius (3), tex_idx (5); the orientation is a uniform
+	if(!instance_buffer) glGenBuffers( 1, &instance_buffer );
+	glBindVertexArray( vertex_array );
+	glBindBuffer( GL_ARRAY_BUFFER, instance_buffer );
+	GLsizei stride = sizeof(render_body_t);
+	glEnableVertexAttribArray( 3 );
+	glVertexAttribPointer( 3, 4, GL_FLOAT, GL_FALSE, stride, (const void*) offsetof(render_body_t, center_radius) );
+	glVertexAttribDivisor( 3, 1 );
+	glEnableVertexAttribArray( 5 );
+	glVertexAttribIPointer( 5, 1, GL_INT, stride, (const void*) offsetof(render_body_t, tex_idx) );
+	glVertexAttribDivisor( 5, 1 );
+	glBindVertexArray( 0 );
+}
+
+void set_wall_vao( const wall_t& wall, wall_mesh_t& mesh )
+{
+	// clear and create new buffers
+	if(mesh.vertex_buffer){	glDeleteBuffers( 1, &mesh.vertex_buffer );	mesh.vertex_buffer = 0; }
+	if(mesh.index_buffer){	glDeleteBuffers( 1, &mesh.index_buffer );	mesh.index_buffer = 0; }
+
+	// check exceptions
+	if(wall.vertices.empty()){ printf("[error] vertices is empty.\n"); return; }
+
+	// every vertex takes the plane normal
+	std::vector<vertex> vertices;
+	for (auto& p : wall.vertices) vertices.push_back({ p, wall.normal, vec2(0) });
+
+	// generation of vertex buffer
+	glGenBuffers( 1, &mesh.vertex_buffer );
+	glBindBuffer( GL_ARRAY_BUFFER, mesh.vertex_buffer );
+	glBufferData( GL_ARRAY_BUFFER, sizeof(vertex)*vertices.size(), &vertices[0], GL_STATIC_DRAW );
+
+	// geneation of index buffer
+	glGenBuffers( 1, &mesh.index_buffer );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, mesh.index_buffer );
+	glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof(uint)*wall.indices.size(), &wall.indices[0], GL_STATIC_DRAW );
+
+	// generate vertex array object, which is mandatory for OpenGL 3.3 and higher
+	if(mesh.vertex_array) glDeleteVertexArrays(1,&mesh.vertex_array);
+	mesh.vertex_array = cg_create_vertex_array( mesh.vertex_buffer, mesh.index_buffer );
+	if(!mesh.vertex_array){ printf("%s(): failed to create vertex aray\n",__func__); return; }
+}
+
+void update_wall_meshes()
+{
+	wall_meshes.resize(cornell_box.size());
+	for (size_t k = 0; k < cornell_box.size(); k++)
+		if (!cornell_box[k].vertices.empty()) set_wall_vao(cornell_box[k], wall_meshes[k]);
+}
+
+void print_replay_status()
+{
+	printf("> replay frame %llu / %llu (t = %.3f s), %gx%s\n", (unsigned long long) player.frame, (unsigned long long) player.frame_count(),
+		player.time(), player.rate, b_is_rotate ? "" : ", paused");
+}
+
+// replay keys; false for the keys of the viewer
+bool replay_keyboard( int key, int mods )
+{
+	float step = (mods & GLFW_MOD_SHIFT) ? 1.0f : 1.0f / player.reader.header.frame_dt;	// frames
+	if (key == GLFW_KEY_LEFT)			player.seek(player.frame - step);
+	else if (key == GLFW_KEY_RIGHT)		player.seek(player.frame + step);
+	else if (key == GLFW_KEY_COMMA)		player.set_rate(-fabsf(player.rate));
+	else if (key == GLFW_KEY_PERIOD)	player.set_rate(fabsf(player.rate));
+	else if (key == GLFW_KEY_UP)		player.set_rate(player.rate * 2.0f);
+	else if (key == GLFW_KEY_DOWN)		player.set_rate(player.rate * 0.5f);
+	else if (key == GLFW_KEY_F5 || key == GLFW_KEY_F9) { printf("> snapshots are not available in a replay\n"); return true; }
+	else return false;
+	if (key == GLFW_KEY_LEFT || key == GLFW_KEY_RIGHT) player.advance(0.0f, bodies);
+	print_replay_status();
+	return true;
+}
+
+// starts writing a snapshot in the background; stepping goes on
+void save_scene( const char* path )
+{
+	snapshot_info_t info;
+	info.time = stepper.time;
+	info.step_count = physics.step_count;
+	info.seed = seed;
+	info.rng = rng;
+	if (snapshot_writer.save(path, bodies, cornell_box, info)) printf("> saving %zu spheres to %s\n", bodies.size(), path);
+	else printf("> still writing the previous snapshot\n");
+}
+
+bool load_scene( const char* path )
+{
+	snapshot_writer.wait();
+	snapshot_info_t info;
+	size_t walls = cornell_box.size();
+	if (!load_snapshot(path, bodies, cornell_box, info)) return false;
+	seed = info.seed;
+	rng = info.rng;
+	physics.reset();
+	physics.step_count = info.step_count;
+	stepper.time = info.time;
+	sim.b_changed = true;
+	if (cornell_box.size() != walls) update_wall_meshes();
+	if (recorder.is_open() && bodies.size() != recorder.header.body_count)
+	{
+		recorder.close();
+		physics.recorder = nullptr;
+		printf("> the body count changed; stopped recording %s\n", record_path);
+	}
+	printf("> loaded %zu spheres from %s (step %llu)\n", bodies.size(), path, (unsigned long long) info.step_count);
+	return true;
 }
 
 void update_tess()
@@ -364,8 +536,13 @@ void update_tess()
 
 void keyboard( GLFWwindow* window, int key, int scancode, int action, int mods )
 {
+	if (player.is_open() && (action == GLFW_PRESS || action == GLFW_REPEAT) && replay_keyboard(key, mods)) return;
 	if(action==GLFW_PRESS)
 	{
+		// the keys edit the physics between two advances of sim
+		std::unique_lock<std::mutex> lock;
+		if (sim.is_running()) lock = sim.edit();
+
 		if(key==GLFW_KEY_ESCAPE||key==GLFW_KEY_Q)	glfwSetWindowShouldClose( window, GL_TRUE );
 		else if(key==GLFW_KEY_H||key==GLFW_KEY_F1)	print_help();
 		else if(key==GLFW_KEY_KP_ADD||(key==GLFW_KEY_EQUAL&&(mods&GLFW_MOD_SHIFT)))	b.add = true;
@@ -390,6 +567,61 @@ void keyboard( GLFWwindow* window, int key, int scancode, int action, int mods )
 		{
 			b_shadow = !b_shadow;
 		}
+		else if (key == GLFW_KEY_B)
+		{
+			physics.broadphase = broadphase_mode((physics.broadphase + 1) % BROADPHASE_COUNT);
+			printf("> using %s broadphase\n", BROADPHASE_NAME[physics.broadphase]);
+		}
+		else if (key == GLFW_KEY_K)
+		{
+			physics.b_pair_cache = !physics.b_pair_cache;
+			physics.pair_cache.invalidate();
+			printf("> %s the pair cache\n", physics.b_pair_cache ? "using" : "not using");
+		}
+		else if (key == GLFW_KEY_P)
+		{
+			physics.b_parallel = !physics.b_parallel;
+			printf("> using %s solver (%u threads)\n", physics.b_parallel ? "parallel" : "serial", physics.b_parallel ? get_job_system().size() : 1);
+		}
+		else if (key == GLFW_KEY_C)
+		{
+			physics.b_ccd = !physics.b_ccd;
+			stepper.step = (physics.b_ccd ? CCD_STEP_RATIO : 1.0f) / PHYSICS_HZ;
+			stepper.cfl = (physics.b_ccd ? CCD_STEP_RATIO : 1.0f) * CFL_LIMIT;
+			printf("> %s continuous collision detection (%.0f Hz physics)\n", physics.b_ccd ? "using" : "not using", 1.0f / stepper.step);
+		}
+		else if (key == GLFW_KEY_A)
+		{
+			if (recorder.is_open()) printf("> the recording needs fixed steps\n");
+			else
+			{
+				if (stepper.b_adaptive) printf("> using fixed steps (adaptive: %.2f substeps / frame, max %d)\n",
+					double(stepper.total_substeps) / std::max(double(stepper.frames), 1.0), stepper.peak_substeps);
+				else printf("> using adaptive substeps (|v|*dt/r <= %.2f)\n", stepper.cfl);
+				stepper.b_adaptive = !stepper.b_adaptive;
+				stepper.reset_stats();
+				stepper.accumulator = 0.0;
+			}
+		}
+		else if (key == GLFW_KEY_V)
+		{
+			physics.b_event = !physics.b_event;
+			printf("> using %s engine\n", physics.b_event ? "event-driven" : "time-stepping");
+		}
+		else if (key == GLFW_KEY_G)
+		{
+			physics.b_gravity = !physics.b_gravity;
+			if (physics.b_gravity) set_density_masses(bodies);	// kept when gravity is turned off
+			printf("> gravity %s (theta = %.2f)\n", physics.b_gravity ? "on" : "off", physics.gravity.theta);
+		}
+		else if (key == GLFW_KEY_N)
+		{
+			physics.integrator = integrator_mode((physics.integrator + 1) % INTEGRATOR_COUNT);
+			physics.integration.clear();
+			printf("> using %s integrator\n", INTEGRATOR_NAME[physics.integrator]);
+		}
+		else if (key == GLFW_KEY_F5)	save_scene(snapshot_path);
+		else if (key == GLFW_KEY_F9)	load_scene(snapshot_path);
 #ifndef GL_ES_VERSION_2_0
 		else if(key==GLFW_KEY_W)
 		{
@@ -425,7 +657,20 @@ void mouse( GLFWwindow* window, int button, int action, int mods )
 
 	if(button==GLFW_MOUSE_BUTTON_LEFT ) 
 	{ 
-		if (mods & GLFW_MOD_SHIFT) 
+		if (mods & GLFW_MOD_ALT)
+		{ // picking
+			if (action == GLFW_PRESS)
+			{
+				std::unique_lock<std::mutex> lock;
+				if (sim.is_running()) lock = sim.edit();
+				float hit_t;
+				physics.tree.update(bodies);
+				int k = physics.tree.ray_cast(bodies, cam.eye, pick_ray(cam, npos), &hit_t);
+				if (k < 0) printf("> picked nothing\n");
+				else printf("> picked sphere %d (radius = %.1f, distance = %.1f)\n", k, bodies.radius[k], hit_t);
+			}
+		}
+		else if (mods & GLFW_MOD_SHIFT) 
 		{ // zooming
 			if (action == GLFW_PRESS)			tb.begin_zooming(cam, npos);
 			else if (action == GLFW_RELEASE)	tb.end_zooming();
@@ -465,10 +710,10 @@ void motion( GLFWwindow* window, double x, double y )
 }
 
 // NOTE: refer gl-06-texture
-GLuint create_texture(const char* image_path, bool mipmap = true, GLenum wrap = GL_CLAMP_TO_EDGE, GLenum filter = GL_LINEAR)
+// takes the image decoded by cg_load_image() and releases it
+GLuint create_texture(image* i, bool mipmap = true, GLenum wrap = GL_CLAMP_TO_EDGE, GLenum filter = GL_LINEAR)
 {
-	// load image
-	image* i = cg_load_image(image_path); if (!i) return 0; // return null texture; 0 is reserved as a null texture
+	if (!i) return 0; // return null texture; 0 is reserved as a null texture
 	int		w = i->width, h = i->height, c = i->channels;
 
 	// induce internal format and format from image
@@ -515,36 +760,142 @@ bool user_init()
 	cornell_box = create_cornellbox();
 
 	// create spheres
-	spheres = create_spheres(sphere_count);
-
-	// define the position of four corner vertices
-	unit_sphere_vertices = std::move(create_sphere_vertices( NUM_LONGITUDE, NUM_LATITUDE));
+	box_interior(cornell_box, spawn.lo, spawn.hi);
+	spawn.seed = seed;
+	if (b_fit_radii) fit_radii(spawn);
+	bodies.clear();
+	if (replay_path)
+	{
+		if (!player.open(replay_path, bodies)) return false;
+		const trajectory_header_t& h = player.reader.header;
+		vec3 lo = vec3(h.lo[0], h.lo[1], h.lo[2]), size = vec3(h.hi[0], h.hi[1], h.hi[2]) - lo;
+		if (size.x > 0 && size.y > 0 && size.z > 0 && lo.x == 0 && lo.y == 0 && lo.z == -size.z) cornell_box = create_box(size);
+		printf("> replaying %llu frames of %zu spheres from %s\n", (unsigned long long) player.frame_count(), bodies.size(), replay_path);
+	}
+	else if (load_path) { if (!load_scene(load_path)) return false; }
+	else
+	{
+		rng = rng_t(seed);
+		uint placed = spawn_spheres(bodies, spawn, rng);
+		if (placed < spawn.count) printf("> placed %u of %u spheres (radius %.2f ~ %.2f)\n", placed, spawn.count, spawn.min_radius, spawn.max_radius);
+		if (physics.b_gravity) set_density_masses(bodies);
+	}
+	stepper.step = (physics.b_ccd ? CCD_STEP_RATIO : 1.0f) / PHYSICS_HZ;
+	stepper.cfl = (physics.b_ccd ? CCD_STEP_RATIO : 1.0f) * CFL_LIMIT;
+	update_wall_meshes();
+	if (record_path && !player.is_open())
+	{
+		if (!recorder.open(record_path, bodies, spawn.lo, spawn.hi, stepper.step, stepper.time)) return false;
+		recorder.push(bodies);
+		physics.recorder = &recorder;
+		printf("> recording every step to %s\n", record_path);
+	}
+	if (!player.is_open()) sim.start(stepper, physics, bodies, cornell_box);
+
+	// decode the images and build the sphere vertices on the job system;
+	// the GL objects are created here, on the thread of the GL context
+	job_system_t& jobs = get_job_system();
+	struct { const char* path; GLuint* texture; image* i; } textures[] = {
+		{ sun_image_path, &SUN, nullptr }, { mercury_image_path, &MERCURY, nullptr }, { venus_image_path, &VENUS, nullptr },
+		{ earth_image_path, &EARTH, nullptr }, { mars_image_path, &MARS, nullptr }, { jupiter_image_path, &JUPITER, nullptr },
+		{ saturn_image_path, &SATURN, nullptr }, { uranus_image_path, &URANUS, nullptr }, { neptune_image_path, &NEPTUNE, nullptr } };
+	std::vector<job_handle_t> decoded;
+	for (auto& tex : textures) decoded.push_back(jobs.spawn([&tex]() { tex.i = cg_load_image(tex.path); }));
+	job_handle_t mesh = jobs.spawn([]() { unit_sphere_vertices = create_sphere_vertices(NUM_LONGITUDE, NUM_LATITUDE); });
 
 	// create vertex buffer; called again when index buffering mode is toggled
+	jobs.wait(mesh);
 	update_vertex_buffer(unit_sphere_vertices
 		, NUM_LONGITUDE
 		, NUM_LATITUDE);
 
-	// load images to texture
-	SUN = create_texture(sun_image_path, true); if (!SUN) return false;
-	MERCURY = create_texture(mercury_image_path, true); if (!MERCURY) return false;
-	VENUS = create_texture(venus_image_path, true); if (!VENUS) return false;
-	EARTH = create_texture(earth_image_path, true); if (!EARTH) return false;
-	MARS = create_texture(mars_image_path, true); if (!MARS) return false;
-	JUPITER = create_texture(jupiter_image_path, true); if (!JUPITER) return false;
-	SATURN = create_texture(saturn_image_path, true); if (!SATURN) return false;
-	URANUS = create_texture(uranus_image_path, true); if (!URANUS) return false;
-	NEPTUNE = create_texture(neptune_image_path, true); if (!NEPTUNE) return false;
+	// load images to texture; every job is waited for, the images live on this stack
+	bool b_textures = true;
+	for (size_t k = 0; k < decoded.size(); k++)
+	{
+		jobs.wait(decoded[k]);
+		*textures[k].texture = create_texture(textures[k].i, true);
+		if (!*textures[k].texture) b_textures = false;
+	}
 
-	return true;
+	return b_textures;
 }
 
 void user_finalize()
 {
+	sim.stop();
+	snapshot_writer.wait();
+	recorder.close();
+	physics.recorder = nullptr;
+	player.close();
+	if (physics.hash_log) fclose(physics.hash_log);
+}
+
+// --deterministic: bit-reproducible physics with a state hash per step
+// --seed N: scene seed
+// --hash-log FILE: write "step hash" lines to FILE (implies --deterministic)
+// --gravity [THETA]: mutual gravity with the Barnes-Hut opening angle THETA
+// --spheres N: number of spheres; radii shrink to fit unless --radius is given
+// --spawn poisson|lattice: placement of the spheres
+// --radius MIN MAX: radius range
+// --power EXP: radii distributed as r^-EXP instead of uniformly
+// --load FILE: start from a snapshot instead of spawning
+// --snapshot FILE: file of F5 (save) and F9 (load)
+// --record FILE: compressed trajectory of every physics step (see trajectory.h)
+// --replay FILE: play a recorded trajectory back instead of simulating
+bool parse_args(int argc, char* argv[])
+{
+	for (int k = 1; k < argc; k++)
+	{
+		if (strcmp(argv[k], "--deterministic") == 0) physics.b_deterministic = true;
+		else if (strcmp(argv[k], "--seed") == 0 && k + 1 < argc) seed = strtoull(argv[++k], nullptr, 10);
+		else if (strcmp(argv[k], "--hash-log") == 0 && k + 1 < argc)
+		{
+			if (!(physics.hash_log = fopen(argv[++k], "w"))) { printf("Failed to open %s\n", argv[k]); return false; }
+			physics.b_deterministic = true;
+		}
+		else if (strcmp(argv[k], "--gravity") == 0)
+		{
+			physics.b_gravity = true;
+			if (k + 1 < argc && argv[k + 1][0] != '-') physics.gravity.theta = float(atof(argv[++k]));
+		}
+		else if (strcmp(argv[k], "--integrator") == 0 && k + 1 < argc)
+		{
+			int m = 0;
+			for (k++; m < INTEGRATOR_COUNT && strcmp(argv[k], INTEGRATOR_NAME[m]) != 0; m++);
+			if (m == INTEGRATOR_COUNT) { printf("unknown integrator %s\n", argv[k]); return false; }
+			physics.integrator = integrator_mode(m);
+		}
+		else if (strcmp(argv[k], "--spheres") == 0 && k + 1 < argc) spawn.count = uint(strtoul(argv[++k], nullptr, 10));
+		else if (strcmp(argv[k], "--spawn") == 0 && k + 1 < argc) spawn.mode = strcmp(argv[++k], SPAWN_NAME[SPAWN_LATTICE]) == 0 ? SPAWN_LATTICE : SPAWN_POISSON;
+		else if (strcmp(argv[k], "--radius") == 0 && k + 2 < argc)
+		{
+			spawn.min_radius = float(atof(argv[++k]));
+			spawn.max_radius = std::max(float(atof(argv[++k])), spawn.min_radius);
+			b_fit_radii = false;
+		}
+		else if (strcmp(argv[k], "--power") == 0 && k + 1 < argc) { spawn.dist = RADIUS_POWER; spawn.exponent = float(atof(argv[++k])); }
+		else if (strcmp(argv[k], "--load") == 0 && k + 1 < argc) load_path = argv[++k];
+		else if (strcmp(argv[k], "--snapshot") == 0 && k + 1 < argc) snapshot_path = argv[++k];
+		else if (strcmp(argv[k], "--record") == 0 && k + 1 < argc) record_path = argv[++k];
+		else if (strcmp(argv[k], "--replay") == 0 && k + 1 < argc) replay_path = argv[++k];
+		else
+		{
+			printf("usage: %s [--deterministic] [--seed N] [--hash-log FILE] [--gravity [THETA]]\n", argv[0]);
+			printf("          [--integrator symplectic-euler|verlet|rk4]\n");
+			printf("          [--spheres N] [--spawn poisson|lattice] [--radius MIN MAX] [--power EXP]\n");
+			printf("          [--load FILE] [--snapshot FILE] [--record FILE] [--replay FILE]\n");
+			return false;
+		}
+	}
+	if (physics.b_deterministic) printf("> deterministic mode (seed = %llu)\n", (unsigned long long) seed);
+	return true;
 }
 
 int main( int argc, char* argv[] )
 {
+	if(!parse_args( argc, argv )) return 1;
+
 	// create window and initialize OpenGL extensions
 	if(!(window = cg_create_window( window_name, window_size.x, window_size.y ))){ glfwTerminate(); return 1; }
 	if(!cg_init_extensions( window )){ glfwTerminate(); return 1; }	// init OpenGL extensions
@@ -0,0 +1,61 @@
+#pragma once
+#ifndef __NARROWPHASE_H__
+#define __NARROWPHASE_H__
+
+#include <vector>
+
+/*
+* Narrowphase and elastic impulse over candidate pairs
+* - overlap_run(): squared distance test of one sphere against contiguous spheres, SIMD_WIDTH
+*   loads at a time; the grid stores its cells as such runs
+* - resolve_contacts(): broadphase pairs in arbitrary order, tested and resolved one by one;
+*   gathering the bodies of SIMD_WIDTH pairs and computing the impulse in the lanes measured
+*   0.6~0.8x of this loop on the grid and tree pairs, since the test is bound by the loads
+* - templates of the scalar type: simd_of<Real>::width lanes per block
+*/
+// tests one sphere against count spheres stored contiguously; emit(k) for each overlapping k
+template <typename Real, typename F>
+inline void overlap_run(Real x, Real y, Real z, Real r, const Real* px, const Real* py, const Real* pz, const Real* pr, uint count, F emit)
+{
+	typedef typename simd_of<Real>::type simd;
+	const uint W = simd_of<Real>::width;
+	uint k = 0;
+	simd cx = simd_set1(x), cy = simd_set1(y), cz = simd_set1(z), cr = simd_set1(r);
+	for (; k + W <= count; k += W)
+	{
+		simd dx = simd_sub(cx, simd_load(px + k)), dy = simd_sub(cy, simd_load(py + k)), dz = simd_sub(cz, simd_load(pz + k));
+		simd rs = simd_add(cr, simd_load(pr + k));
+		simd d2 = simd_add(simd_add(simd_mul(dx, dx), simd_mul(dy, dy)), simd_mul(dz, dz));
+		for (int bits = simd_bits(simd_le(d2, simd_mul(rs, rs))), l = 0; bits; bits >>= 1, l++)
+			if (bits & 1) emit(k + l);
+	}
+
+	// scalar tail
+	for (; k < count; k++)
+	{
+		Real dx = x - px[k], dy = y - py[k], dz = z - pz[k], rs = r + pr[k];
+		if (dx * dx + dy * dy + dz * dz <= rs * rs) emit(k);
+	}
+}
+
+// returns the number of overlapping pairs
+template <typename Real>
+inline size_t resolve_contacts(basic_body_store_t<Real>& b, const pair_t* pairs, size_t n)
+{
+	size_t contacts = 0;
+	for (size_t k = 0; k < n; k++)
+	{
+		if (!is_collide(b, pairs[k].a, pairs[k].b)) continue;
+		resolve_elastic(b, pairs[k].a, pairs[k].b);
+		contacts++;
+	}
+	return contacts;
+}
+
+template <typename Real>
+inline size_t resolve_contacts(basic_body_store_t<Real>& b, const std::vector<pair_t>& pairs)
+{
+	return resolve_contacts(b, pairs.data(), pairs.size());
+}
+
+#endif
@@ -0,0 +1,261 @@
+#pragma once
+#ifndef __OCTREE_H__
+#define __OCTREE_H__
+
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+/*
+* Octree over body centers with mass moments
+* - bodies are sorted by 30-bit Morton code (radix sort), so every node is a contiguous
+*   range of the sorted order and children split the range by the next 3 code bits
+* - the top OCTREE_TASK_DEPTH levels are built serially, the subtrees below in parallel into
+*   per-task node lists that are appended in task order, so the layout does not depend on
+*   the thread count
+* - every node keeps the total mass and the center of mass for Barnes-Hut; query() reuses
+*   the same tree for box queries
+*/
+static const uint OCTREE_LEAF_SIZE = 8;		// max bodies per leaf (unless at max depth)
+static const int OCTREE_MAX_DEPTH = 10;		// 10 bits per axis in the Morton code
+static const int OCTREE_TASK_DEPTH = 2;		// levels built before splitting into parallel tasks
+
+struct octree_node_t
+{
+	vec3	com = vec3(0);			// center of mass
+	float	mass = 0.0f;
+	vec3	center = vec3(0);		// cell center
+	float	half = 0.0f;			// half edge of the cell
+	uint	child = 0;				// first child; children are contiguous
+	uint	child_count = 0;		// 0: leaf
+	uint	begin = 0, end = 0;		// range in order
+
+	bool	is_leaf() const { return child_count == 0; }
+};
+
+struct octree_t
+{
+	std::vector<octree_node_t>	nodes;		// nodes[0]: root
+	std::vector<uint>			order;		// body indices sorted by Morton code
+	std::vector<uint>			rank;		// position of each body in order
+	std::vector<uint32_t>		code, tmp_code;
+	std::vector<uint>			tmp_order;
+	vec3						lo = vec3(0);	// cube bounds
+	float						size = 1.0f;	// cube edge
+	mutable std::vector<uint>	stack;
+
+	// public functions
+	void	build( const body_store_t& bodies, const float* mass );
+	template <typename F>
+	void	query( const body_store_t& bodies, const aabb_t& box, F callback ) const;	// callback(uint body) per center in box
+
+	// internal functions
+	void	sort_codes( const body_store_t& bodies );
+	void	build_node( std::vector<octree_node_t>& out, uint node, int level, const body_store_t& bodies, const float* mass, std::vector<std::pair<uint, int>>* tasks );
+	void	finish_node( octree_node_t& n, const std::vector<octree_node_t>& list, const body_store_t& bodies, const float* mass ) const;
+	void	refit_top( uint node, int level );
+};
+
+// interleaves the lower 10 bits of x with two zero bits
+inline uint32_t morton_spread(uint32_t x)
+{
+	x &= 0x3ff;
+	x = (x | (x << 16)) & 0x030000ff;
+	x = (x | (x << 8)) & 0x0300f00f;
+	x = (x | (x << 4)) & 0x030c30c3;
+	x = (x | (x << 2)) & 0x09249249;
+	return x;
+}
+
+inline void octree_t::sort_codes(const body_store_t& b)
+{
+	uint n = uint(b.size());
+
+	// cube around the centers
+	vec3 hi = vec3(-FLT_MAX);
+	lo = vec3(FLT_MAX);
+	for (uint i = 0; i < n; i++)
+	{
+		vec3 c = b.center(i);
+		lo = vec3(std::min(lo.x, c.x), std::min(lo.y, c.y), std::min(lo.z, c.z));
+		hi = vec3(std::max(hi.x, c.x), std::max(hi.y, c.y), std::max(hi.z, c.z));
+	}
+	if (n == 0) lo = hi = vec3(0);
+	size = std::max(std::max(hi.x - lo.x, hi.y - lo.y), std::max(hi.z - lo.z, 1e-3f)) * 1.0001f;
+
+	code.resize(n);
+	float scale = 1024.0f / size;
+	parallel_for(n, 4096, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			uint32_t x = uint32_t((b.px[i] - lo.x) * scale), y = uint32_t((b.py[i] - lo.y) * scale), z = uint32_t((b.pz[i] - lo.z) * scale);
+			code[i] = morton_spread(x) << 2 | morton_spread(y) << 1 | morton_spread(z);
+		}
+	});
+
+	// LSD radix sort of (code, index): 3 passes of 10 bits, stable
+	order.resize(n);
+	for (uint i = 0; i < n; i++) order[i] = i;
+	tmp_order.resize(n);
+	tmp_code.resize(n);
+	for (int shift = 0; shift < 30; shift += 10)
+	{
+		uint count[1025] = {};
+		for (uint i = 0; i < n; i++) count[(code[i] >> shift & 1023) + 1]++;
+		for (int k = 0; k < 1024; k++) count[k + 1] += count[k];
+		for (uint i = 0; i < n; i++)
+		{
+			uint k = count[code[i] >> shift & 1023]++;
+			tmp_code[k] = code[i];
+			tmp_order[k] = order[i];
+		}
+		code.swap(tmp_code);
+		order.swap(tmp_order);
+	}
+	rank.resize(n);
+	for (uint k = 0; k < n; k++) rank[order[k]] = k;
+}
+
+// mass moments of a node from its children in list, or from its bodies for a leaf
+inline void octree_t::finish_node(octree_node_t& n, const std::vector<octree_node_t>& list, const body_store_t& b, const float* mass) const
+{
+	vec3 moment = vec3(0);
+	float m = 0.0f;
+	if (n.is_leaf())
+	{
+		for (uint k = n.begin; k < n.end; k++)
+		{
+			uint i = order[k];
+			moment += b.center(i) * mass[i];
+			m += mass[i];
+		}
+	}
+	else
+	{
+		for (uint c = n.child; c < n.child + n.child_count; c++)
+		{
+			moment += list[c].com * list[c].mass;
+			m += list[c].mass;
+		}
+	}
+	n.mass = m;
+	n.com = m > 0.0f ? moment / m : n.center;
+}
+
+// splits out[node] and recurses; below OCTREE_TASK_DEPTH the split is deferred to tasks when given
+inline void octree_t::build_node(std::vector<octree_node_t>& out, uint node, int level, const body_store_t& b, const float* mass, std::vector<std::pair<uint, int>>* tasks)
+{
+	octree_node_t n = out[node];
+	if (n.end - n.begin > OCTREE_LEAF_SIZE && level < OCTREE_MAX_DEPTH)
+	{
+		if (tasks && level == OCTREE_TASK_DEPTH) { tasks->emplace_back(node, level); return; }
+
+		// children by the 3 code bits of this level
+		int shift = 3 * (OCTREE_MAX_DEPTH - 1 - level);
+		n.child = uint(out.size());
+		for (uint k = n.begin; k < n.end;)
+		{
+			uint octant = code[k] >> shift & 7, e = k;
+			while (e < n.end && (code[e] >> shift & 7) == octant) e++;
+
+			octree_node_t c;
+			c.half = n.half * 0.5f;
+			c.center = n.center + vec3(octant & 4 ? c.half : -c.half, octant & 2 ? c.half : -c.half, octant & 1 ? c.half : -c.half);
+			c.begin = k;
+			c.end = e;
+			out.push_back(c);
+			n.child_count++;
+			k = e;
+		}
+		out[node] = n;
+		for (uint c = n.child; c < n.child + n.child_count; c++) build_node(out, c, level + 1, b, mass, tasks);
+		n = out[node];
+	}
+	if (!tasks || n.is_leaf()) finish_node(n, out, b, mass);
+	out[node] = n;
+}
+
+// mass moments of the serially built levels, after the tasks have filled the subtrees
+inline void octree_t::refit_top(uint node, int level)
+{
+	octree_node_t& n = nodes[node];
+	if (n.is_leaf() || level >= OCTREE_TASK_DEPTH) return;
+	vec3 moment = vec3(0);
+	float m = 0.0f;
+	for (uint c = n.child; c < n.child + n.child_count; c++)
+	{
+		refit_top(c, level + 1);
+		moment += nodes[c].com * nodes[c].mass;
+		m += nodes[c].mass;
+	}
+	n.mass = m;
+	n.com = m > 0.0f ? moment / m : n.center;
+}
+
+inline void octree_t::build(const body_store_t& b, const float* mass)
+{
+	nodes.clear();
+	uint n = uint(b.size());
+	if (n == 0) return;
+	sort_codes(b);
+
+	octree_node_t root;
+	root.half = size * 0.5f;
+	root.center = lo + vec3(root.half);
+	root.begin = 0;
+	root.end = n;
+	nodes.push_back(root);
+
+	// top levels, then one subtree per task
+	std::vector<std::pair<uint, int>> tasks;
+	build_node(nodes, 0, 0, b, mass, &tasks);
+	std::vector<std::vector<octree_node_t>> local(tasks.size());
+	parallel_for(tasks.size(), 1, [&](size_t begin, size_t end)
+	{
+		for (size_t t = begin; t < end; t++)
+		{
+			local[t].push_back(nodes[tasks[t].first]);
+			build_node(local[t], 0, tasks[t].second, b, mass, nullptr);
+		}
+	});
+
+	// append in task order; local index k > 0 becomes base + k - 1
+	for (size_t t = 0; t < tasks.size(); t++)
+	{
+		uint base = uint(nodes.size());
+		for (size_t k = 1; k < local[t].size(); k++)
+		{
+			octree_node_t c = local[t][k];
+			if (!c.is_leaf()) c.child = base + c.child - 1;
+			nodes.push_back(c);
+		}
+		octree_node_t r = local[t][0];
+		if (!r.is_leaf()) r.child = base + r.child - 1;
+		nodes[tasks[t].first] = r;
+	}
+	refit_top(0, 0);
+}
+
+template <typename F>
+inline void octree_t::query(const body_store_t& b, const aabb_t& box, F callback) const
+{
+	if (nodes.empty()) return;
+	stack.clear();
+	stack.push_back(0);
+	while (!stack.empty())
+	{
+		const octree_node_t& n = nodes[stack.back()];
+		stack.pop_back();
+		aabb_t cell = { n.center - vec3(n.half), n.center + vec3(n.half) };
+		if (!cell.overlaps(box)) continue;
+		if (!n.is_leaf()) { for (uint c = n.child; c < n.child + n.child_count; c++) stack.push_back(c); continue; }
+		for (uint k = n.begin; k < n.end; k++)
+		{
+			uint i = order[k];
+			if (box.lo.x <= b.px[i] && b.px[i] <= box.hi.x && box.lo.y <= b.py[i] && b.py[i] <= box.hi.y && box.lo.z <= b.pz[i] && b.pz[i] <= box.hi.z) callback(i);
+		}
+	}
+}
+
+#endif
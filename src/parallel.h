@@ -0,0 +1,279 @@
+#pragma once
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+* Work-stealing job system shared by the physics, asset loading and render preparation
+* - one deque per worker; a thread pushes and pops its own jobs at the back (the most recent,
+*   still in cache) and steals from the front of the others (the oldest, usually the biggest
+*   pieces) when its deque is empty; threads that are not workers share deque 0
+* - waiting helps: wait() runs queued jobs until what it waits for is done, so nested
+*   parallel_for and fork/join inside jobs never leave a worker blocked
+* - spawn(fn, deps) runs fn once every job of deps finished
+* - parallel_for splits [0,n) into PARALLEL_SPLIT chunks per thread (at least grain items each)
+*   by recursive halving; the chunk boundaries depend only on n and the thread count, and are
+*   multiples of align (but n): with align = SIMD_WIDTH, an item falls in the same SIMD block or
+*   scalar tail of a kernel whatever the thread count
+* - blocking I/O (snapshot, trajectory and replay threads) keeps its own thread: a worker that
+*   sleeps in fwrite() would hold back the jobs in its deque until it is stolen from
+*/
+static const size_t PARALLEL_SPLIT = 4;	// chunks per thread, so that stealing can even out the load
+
+struct job_t
+{
+	void					(*call)(void*) = nullptr;	// fork/join jobs: call(data), no allocation
+	void*					data = nullptr;
+	std::function<void()>	fn;							// spawned jobs
+	std::atomic<int>*		counter = nullptr;	// decremented when the job ends
+	std::atomic<int>		unfinished{ 0 };	// dependencies not finished yet
+	std::atomic<bool>		done{ false };
+	std::mutex				mtx;				// guards done and dependents
+	std::vector<job_t*>		dependents;
+	std::shared_ptr<job_t>	self;				// a spawned job keeps itself alive until it ran
+};
+
+typedef std::shared_ptr<job_t> job_handle_t;
+
+struct job_queue_t
+{
+	std::mutex			mtx;
+	std::deque<job_t*>	jobs;
+};
+
+struct job_system_t
+{
+	std::vector<std::thread>		workers;
+	std::unique_ptr<job_queue_t[]>	queues;			// one per thread; 0: threads that are not workers
+	std::atomic<int>				queued{ 0 };	// jobs in the queues
+	std::atomic<int>				sleeping{ 0 };	// workers waiting for jobs
+	std::atomic<uint64_t>			steals{ 0 };
+	std::mutex						sleep_mtx;
+	std::condition_variable			cv;
+	bool							quit = false;
+
+	job_system_t( uint threads = 0 ) { start(threads); }
+	~job_system_t() { stop(); }
+
+	// public functions
+	uint	size() const { return uint(workers.size()) + 1; }
+	void	start( uint threads );	// 0: hardware concurrency
+	void	stop();
+	void	push( job_t* job );		// runs job when a thread gets to it
+	bool	run_one();				// runs one queued job; false when there is none
+	void	wait( std::atomic<int>& counter );	// helps until counter is 0
+	job_handle_t	spawn( std::function<void()> fn, const std::vector<job_handle_t>& deps = {} );
+	void	wait( const job_handle_t& job );
+
+	// internal functions
+	void	worker( uint index );
+	void	execute( job_t* job );
+	job_t*	pop( uint q );
+	job_t*	steal( uint q );
+};
+
+// queue of the calling thread
+inline uint& worker_index()
+{
+	static thread_local uint index = 0;
+	return index;
+}
+
+inline void job_system_t::start(uint threads)
+{
+	stop();
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	queues.reset(new job_queue_t[threads]);
+	quit = false;
+	for (uint t = 1; t < threads; t++) workers.emplace_back([this, t]() { worker(t); });
+}
+
+inline void job_system_t::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleep_mtx);
+		quit = true;
+	}
+	cv.notify_all();
+	for (auto& w : workers) w.join();
+	workers.clear();
+}
+
+inline void job_system_t::worker(uint index)
+{
+	worker_index() = index;
+	for (;;)
+	{
+		if (run_one()) continue;
+		std::unique_lock<std::mutex> lock(sleep_mtx);
+		sleeping++;
+		cv.wait(lock, [&]() { return quit || queued > 0; });
+		sleeping--;
+		if (quit) return;
+	}
+}
+
+inline void job_system_t::push(job_t* job)
+{
+	job_queue_t& q = queues[worker_index() < size() ? worker_index() : 0];
+	{
+		std::lock_guard<std::mutex> lock(q.mtx);
+		q.jobs.push_back(job);
+	}
+	queued++;
+	if (sleeping > 0)
+	{
+		{ std::lock_guard<std::mutex> lock(sleep_mtx); }	// a worker between its check and its wait gets the notify
+		cv.notify_one();
+	}
+}
+
+inline job_t* job_system_t::pop(uint q)
+{
+	std::lock_guard<std::mutex> lock(queues[q].mtx);
+	if (queues[q].jobs.empty()) return nullptr;
+	job_t* job = queues[q].jobs.back();
+	queues[q].jobs.pop_back();
+	return job;
+}
+
+inline job_t* job_system_t::steal(uint q)
+{
+	for (uint k = 1, n = size(); k < n; k++)
+	{
+		job_queue_t& v = queues[(q + k) % n];
+		std::lock_guard<std::mutex> lock(v.mtx);
+		if (v.jobs.empty()) continue;
+		job_t* job = v.jobs.front();
+		v.jobs.pop_front();
+		steals++;
+		return job;
+	}
+	return nullptr;
+}
+
+inline bool job_system_t::run_one()
+{
+	if (queued <= 0) return false;
+	uint q = worker_index() < size() ? worker_index() : 0;
+	job_t* job = pop(q);
+	if (!job) job = steal(q);
+	if (!job) return false;
+	queued--;
+	execute(job);
+	return true;
+}
+
+inline void job_system_t::execute(job_t* job)
+{
+	if (job->call) job->call(job->data);
+	else job->fn();
+
+	std::vector<job_t*> next;
+	{
+		std::lock_guard<std::mutex> lock(job->mtx);
+		job->done = true;
+		next.swap(job->dependents);
+	}
+	for (job_t* d : next) if (--d->unfinished == 0) push(d);
+
+	// the owner of a counted job may destroy it as soon as the counter drops
+	if (job->counter) { (*job->counter)--; return; }
+	std::shared_ptr<job_t> keep = std::move(job->self);
+}
+
+inline void job_system_t::wait(std::atomic<int>& counter)
+{
+	while (counter > 0) if (!run_one()) std::this_thread::yield();
+}
+
+inline job_handle_t job_system_t::spawn(std::function<void()> fn, const std::vector<job_handle_t>& deps)
+{
+	job_handle_t job = std::make_shared<job_t>();
+	job->fn = std::move(fn);
+	job->self = job;
+	job->unfinished = int(deps.size()) + 1;	// +1 until every dependency is registered
+	for (auto& d : deps)
+	{
+		if (!d) { job->unfinished--; continue; }
+		std::lock_guard<std::mutex> lock(d->mtx);
+		if (d->done) job->unfinished--;
+		else d->dependents.push_back(job.get());
+	}
+	if (--job->unfinished == 0) push(job.get());
+	return job;
+}
+
+inline void job_system_t::wait(const job_handle_t& job)
+{
+	if (!job) return;
+	while (!job->done) if (!run_one()) std::this_thread::yield();
+}
+
+inline job_system_t& get_job_system()
+{
+	static job_system_t jobs;
+	return jobs;
+}
+
+// fn(begin, end) per chunk; the right half of every split is left for other threads to steal
+template <typename F>
+struct parallel_range_t
+{
+	F*		fn;
+	size_t	n, chunks, first, last;	// chunks [first, last) of [0,n)
+	size_t	align;					// chunk boundaries but n are multiples of align
+	job_system_t*	jobs;
+
+	static void call( void* p ) { static_cast<parallel_range_t*>(p)->run(); }
+	size_t bound( size_t c ) const { return c == chunks ? n : n * c / chunks / align * align; }
+	void run()
+	{
+		if (last - first == 1) { size_t b = bound(first), e = bound(last); if (b < e) (*fn)(b, e); return; }
+
+		parallel_range_t right = *this;
+		right.first = last = (first + last) / 2;
+		std::atomic<int> pending(1);
+		job_t job;
+		job.call = call;
+		job.data = &right;
+		job.counter = &pending;
+		jobs->push(&job);
+		run();
+		jobs->wait(pending);
+	}
+};
+
+// runs inline when n is below two grains
+template <typename F>
+inline void parallel_for(size_t n, size_t grain, F fn, size_t align = 1, job_system_t& jobs = get_job_system())
+{
+	size_t chunks = std::min<size_t>(size_t(jobs.size()) * PARALLEL_SPLIT, n / std::max<size_t>(grain, 1));
+	if (jobs.size() < 2 || chunks < 2) { if (n) fn(size_t(0), n); return; }
+	parallel_range_t<F> range = { &fn, n, chunks, 0, chunks, std::max<size_t>(align, 1), &jobs };
+	range.run();
+}
+
+// fork/join: g may run on another thread while f runs here
+template <typename F, typename G>
+inline void parallel_invoke(F f, G g, job_system_t& jobs = get_job_system())
+{
+	std::atomic<int> pending(1);
+	job_t job;
+	job.call = [](void* p) { (*static_cast<G*>(p))(); };
+	job.data = &g;
+	job.counter = &pending;
+	jobs.push(&job);
+	f();
+	jobs.wait(pending);
+}
+
+#endif
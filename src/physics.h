@@ -0,0 +1,171 @@
+#pragma once
+#ifndef __PHYSICS_H__
+#define __PHYSICS_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+/*
+* Per-step driver of the sphere simulation
+* bounce walls (any convex plane set, see container.h) -> broadphase -> elastic response on candidate pairs -> move
+* - b_pair_cache: broadphase pairs are kept across steps and reused until bodies moved too far
+*   (see paircache.h)
+* - b_parallel: per-body passes split across threads, contacts solved in colored batches
+* - b_ccd: bodies move up to their time of impact, resolve it and move on for the rest of the
+*   step, in a few passes (see ccd.h); off by default, as it costs more per simulated second
+* - b_gravity: Barnes-Hut gravity (see gravity.h), integrated by the integrator policy kicks
+*   around the walls, contacts and drift (see integrator.h); not in the event-driven engine
+* - b_event: the step is run by the event-driven engine instead (see event.h)
+* - b_deterministic: pairs are solved in canonical (a,b) order by the colored solver whatever
+*   b_parallel and the broadphase are, so the state is bit-identical for any thread count;
+*   the chunks of the per-body and per-pair passes start at multiples of SIMD_WIDTH, so every
+*   body and pair runs in the same SIMD lane or scalar tail (with no fma contraction, see
+*   fpmode.h, both round alike anyway); an order-independent state hash is computed (and
+*   logged) after every step
+* - recorder: the centers after every step are streamed to a trajectory file (see trajectory.h)
+*/
+static const size_t BODY_GRAIN = 4096;	// min bodies per chunk
+enum broadphase_mode
+{
+	BROADPHASE_ALL_PAIRS = 0,	// every pair, O(N^2)
+	BROADPHASE_GRID,			// uniform grid, rebuilt every step
+	BROADPHASE_SAP,				// incremental sweep and prune
+	BROADPHASE_TREE,			// dynamic AABB tree with fat leaves
+	BROADPHASE_COUNT
+};
+
+static const char* BROADPHASE_NAME[BROADPHASE_COUNT] = { "all-pairs", "grid", "sweep-and-prune", "aabb-tree" };
+
+struct physics_t
+{
+	std::vector<plane_t>	planes;		// container walls of the last step
+	broadphase_mode		broadphase = BROADPHASE_GRID;
+	uniform_grid_t		grid;
+	sweep_and_prune_t	sap;
+	aabb_tree_t			tree;
+	std::vector<pair_t>	pairs;		// candidate pairs of the last broadphase run
+	bool				b_pair_cache = true;
+	pair_cache_t		pair_cache;
+	size_t				tested = 0;		// candidate pairs sphere-tested in the last step (grid: its cell-neighbor pairs)
+	size_t				contacts = 0;	// overlapping pairs of the last step
+	bool				b_parallel = true;
+	contact_batches_t	batches;		// colored contacts of the parallel solver
+	bool				b_ccd = false;
+	ccd_t				ccd;			// time of impact of the last step
+	bool				b_gravity = false;
+	gravity_t			gravity;
+	integrator_mode		integrator = INTEGRATOR_SYMPLECTIC_EULER;
+	integrator_state_t	integration;
+	bool				b_event = false;
+	event_engine_t		events;			// event queue, kept while b_event is on
+	bool				b_deterministic = false;
+	uint64_t			step_count = 0;
+	uint64_t			hash = 0;		// state hash after the last step (b_deterministic)
+	FILE*				hash_log = nullptr;	// "step hash" lines (b_deterministic)
+	trajectory_writer_t*	recorder = nullptr;	// every step is recorded when set (see trajectory.h)
+
+	// public functions
+	void	step( float dt, body_store_t& bodies, const std::vector<wall_t>& walls );
+	template <typename Integrator>
+	void	step_with( float dt, body_store_t& bodies, const std::vector<wall_t>& walls );
+	void	find_pairs( const body_store_t& bodies, float dt );
+	void	finish_step( const body_store_t& bodies );
+	void	reset();	// the bodies were replaced (e.g. a snapshot was loaded)
+	template <typename F>
+	void	for_bodies( size_t n, F fn ) { if (b_parallel) parallel_for(n, BODY_GRAIN, fn, chunk_align()); else fn(size_t(0), n); }
+	size_t	chunk_align() const { return b_deterministic ? SIMD_WIDTH : 1; }
+};
+
+inline void physics_t::find_pairs(const body_store_t& bodies, float dt)
+{
+	if (broadphase == BROADPHASE_GRID)
+	{
+		grid.build(bodies);
+		grid.find_pairs(bodies, pairs);
+	}
+	else if (broadphase == BROADPHASE_SAP)
+	{
+		sap.update(bodies);
+		sap.find_pairs(bodies, pairs);
+	}
+	else if (broadphase == BROADPHASE_TREE)
+	{
+		tree.update(bodies, AABB_LOOKAHEAD_STEPS * std::min(dt, MAX_DT) * VELOCITY_SCALE);
+		tree.find_pairs(bodies, pairs);
+	}
+	else
+	{
+		pairs.clear();
+		for (uint i = 0, n = uint(bodies.size()); i < n; i++)
+			for (uint j = i + 1; j < n; j++)
+				if (aabb_overlap(bodies, i, j)) pairs.push_back(pair_t{ i, j });
+	}
+}
+
+inline void physics_t::step(float dt, body_store_t& bodies, const std::vector<wall_t>& walls)
+{
+	if (b_event) { integration.clear(); tested = 0; contacts = events.advance(bodies, walls, dt); finish_step(bodies); return; }
+	if (!events.count.empty()) { events.clear(); pair_cache.invalidate(); }	// stepping changes the trajectories
+
+	if (integrator == INTEGRATOR_VELOCITY_VERLET) step_with<velocity_verlet_t>(dt, bodies, walls);
+	else if (integrator == INTEGRATOR_RK4) step_with<rk4_t>(dt, bodies, walls);
+	else step_with<symplectic_euler_t>(dt, bodies, walls);
+}
+
+template <typename Integrator>
+inline void physics_t::step_with(float dt, body_store_t& bodies, const std::vector<wall_t>& walls)
+{
+	if (b_gravity) Integrator::begin(integration, gravity, bodies, dt);
+	else integration.clear();
+	get_planes(walls, planes);
+	for_bodies(bodies.size(), [&](size_t b, size_t e) { bounce_walls(bodies, planes, b, e); });
+
+	// cached pairs are already in (a,b) order
+	bool cached = b_pair_cache && pair_cache.update(bodies, dt, [&]() -> const std::vector<pair_t>& { find_pairs(bodies, dt); return pairs; });
+	if (!cached)
+	{
+		find_pairs(bodies, dt);
+		if (b_deterministic) std::sort(pairs.begin(), pairs.end(), [](const pair_t& p, const pair_t& q) { return p.a < q.a || (p.a == q.a && p.b < q.b); });
+	}
+	const std::vector<pair_t>& candidates = cached ? pair_cache.pairs : pairs;
+	tested = !cached && broadphase == BROADPHASE_GRID ? grid.candidates : candidates.size();	// the grid only returns overlapping pairs
+	if (b_parallel || b_deterministic) contacts = solve_contacts_parallel(bodies, candidates, batches, chunk_align());
+	else contacts = resolve_contacts(bodies, candidates);
+
+	if (b_ccd)
+	{
+		ccd.begin(bodies, walls, dt);
+		do
+		{
+			ccd.find_toi(bodies, b_parallel);
+			for_bodies(bodies.size(), [&](size_t b, size_t e) { ccd.advance(bodies, b, e); });
+		} while (ccd.resolve(bodies) && ccd.passes < CCD_PASSES);
+	}
+	else for_bodies(bodies.size(), [&](size_t b, size_t e) { integrate(bodies, dt, b, e); });
+	if (b_gravity) Integrator::end(integration, gravity, bodies, dt);
+	finish_step(bodies);
+}
+
+inline void physics_t::reset()
+{
+	pair_cache.invalidate();
+	events.clear();
+	integration.clear();
+	sap.clear();
+	tree.clear();
+}
+
+inline void physics_t::finish_step(const body_store_t& bodies)
+{
+	step_count++;
+	if (recorder) recorder->push(bodies);
+	if (!b_deterministic) return;
+
+	std::atomic<uint64_t> sum(0);
+	for_bodies(bodies.size(), [&](size_t b, size_t e) { sum += state_hash(bodies, b, e); });
+	hash = sum;
+	if (hash_log) fprintf(hash_log, "%llu %016llx\n", (unsigned long long) step_count, (unsigned long long) hash);
+}
+
+#endif
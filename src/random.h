@@ -0,0 +1,46 @@
+#pragma once
+#ifndef __RANDOM_H__
+#define __RANDOM_H__
+
+#include <cstdint>
+
+/*
+* Seeded random number generator (PCG32)
+* - replaces the global rand() behind randf/randf3 wherever the scene is generated,
+*   so a seed reproduces the same scene on every platform and run
+*/
+static const uint64_t DEFAULT_SEED = 1;
+
+struct rng_t
+{
+	uint64_t	state = 0;
+	uint64_t	inc = 1;
+
+	rng_t( uint64_t seed = DEFAULT_SEED, uint64_t stream = 0 ) { reset(seed, stream); }
+
+	// public functions
+	void		reset( uint64_t seed, uint64_t stream = 0 );
+	uint32_t	next();
+	float		randf( float a, float b ) { return a + (b - a) * float(next() >> 8) * (1.0f / 16777216.0f); }	// [a,b)
+	vec3		randf3( float a, float b ) { float x = randf(a, b), y = randf(a, b); return vec3(x, y, randf(a, b)); }
+};
+
+inline void rng_t::reset(uint64_t seed, uint64_t stream)
+{
+	state = 0;
+	inc = (stream << 1) | 1;
+	next();
+	state += seed;
+	next();
+}
+
+inline uint32_t rng_t::next()
+{
+	uint64_t old = state;
+	state = old * 6364136223846793005ULL + inc;
+	uint32_t xorshifted = uint32_t(((old >> 18) ^ old) >> 27);
+	uint32_t rot = uint32_t(old >> 59);
+	return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+}
+
+#endif
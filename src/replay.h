@@ -0,0 +1,248 @@
+#pragma once
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include <algorithm>
+#include <condition_variable>
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+* Playback of a recorded trajectory (see trajectory.h) without physics
+* - the playhead is a fractional frame moved by the frame time times rate; a negative rate plays
+*   backward; the drawn centers are interpolated between the two frames around it
+* - an I/O thread decodes the frames around the playhead into a cache of decoded frames,
+*   mostly ahead in the playing direction; frames of a chunk are decoded in ascending order,
+*   so playing backward decodes every frame once instead of once per frame from its keyframe
+* - a frame that is not decoded yet holds the playhead instead of skipping it
+*/
+static const size_t	REPLAY_CACHE_BYTES = size_t(256) << 20;	// decoded frames
+static const size_t	REPLAY_MIN_FRAMES = 4;
+static const float	REPLAY_MAX_RATE = 64.0f;
+static const int64_t	REPLAY_LOADING = -2;	// slot being decoded
+
+struct replay_frame_t
+{
+	int64_t		index = -1;			// frame held; -1: free
+	float_array	px, py, pz;
+};
+
+struct replay_player_t
+{
+	trajectory_reader_t	reader;			// used by the I/O thread once open
+	double		frame = 0.0;			// playhead in frames
+	float		rate = 1.0f;			// playback speed; negative plays backward
+	int64_t		shown = -1;				// frame whose centers are in the bodies
+	uint64_t	stalls = 0;				// frames drawn while the playhead waited for the I/O thread
+
+	// shared with the I/O thread
+	std::vector<replay_frame_t>	cache;
+	int64_t		wanted = 0;				// frame at the playhead
+	int			direction = 1;			// sign of rate
+	size_t		ahead = 0, behind = 0;	// prefetch window around wanted
+	std::mutex	mutex;
+	std::condition_variable	cv;
+	bool		b_stop = false;
+	std::thread	worker;
+
+	replay_player_t() = default;
+	replay_player_t( const replay_player_t& ) = delete;
+	replay_player_t& operator=( const replay_player_t& ) = delete;
+	~replay_player_t() { close(); }
+
+	// public functions
+	bool	open( const char* path, body_store_t& bodies );
+	void	close();
+	bool	is_open() const { return worker.joinable(); }
+	uint64_t	frame_count() const { return reader.frame_count(); }
+	double	time() const { return reader.header.start_time + frame * reader.header.frame_dt; }
+	void	advance( float dt, body_store_t& bodies );	// moves the playhead by dt of real time and updates the bodies
+	void	seek( double f );
+	void	set_rate( float r );
+
+	// internal functions
+	void	run();
+	int64_t	next_missing() const;	// under mutex; -1 when the window is decoded
+	const replay_frame_t*	find( int64_t f ) const;
+	void	request( int64_t f );
+};
+
+inline bool replay_player_t::open(const char* path, body_store_t& bodies)
+{
+	close();
+	if (!reader.open(path)) return false;
+	if (!reader.frame_count()) { printf("%s has no frame\n", path); reader.close(); return false; }
+
+	size_t n = reader.body_count(), frame_bytes = std::max(n, size_t(1)) * 3 * sizeof(float);
+	size_t slots = std::max(REPLAY_CACHE_BYTES / frame_bytes, REPLAY_MIN_FRAMES);
+	slots = std::min(slots, size_t(2 * reader.header.keyframe_interval + 2));
+	slots = size_t(std::min(uint64_t(slots), std::max(reader.frame_count(), uint64_t(REPLAY_MIN_FRAMES))));
+	cache.assign(slots, replay_frame_t());
+	behind = slots / 4;
+	ahead = slots - behind - 1;
+
+	reader.init_bodies(bodies);
+	replay_frame_t& first = cache[0];
+	for (float_array* a : { &first.px, &first.py, &first.pz }) a->resize(n);
+	if (!reader.read_frame(0, first.px.data(), first.py.data(), first.pz.data())) { reader.close(); return false; }
+	first.index = 0;
+
+	frame = 0.0;
+	rate = 1.0f;
+	stalls = 0;
+	shown = -1;
+	wanted = 0;
+	direction = 1;
+	b_stop = false;
+	worker = std::thread([this]() { run(); });
+	advance(0.0f, bodies);
+	return true;
+}
+
+inline void replay_player_t::close()
+{
+	if (worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			b_stop = true;
+		}
+		cv.notify_all();
+		worker.join();
+	}
+	reader.close();
+	cache.clear();
+}
+
+inline const replay_frame_t* replay_player_t::find(int64_t f) const
+{
+	for (auto& c : cache) if (c.index == f) return &c;
+	return nullptr;
+}
+
+inline int64_t replay_player_t::next_missing() const
+{
+	int64_t last = int64_t(frame_count()) - 1, f = -1;
+	for (int64_t d = 0; d <= int64_t(ahead) && f < 0; d++)
+	{
+		int64_t g = wanted + direction * d;
+		if (g >= 0 && g <= last && !find(g)) f = g;
+	}
+	for (int64_t d = 1; d <= int64_t(behind) && f < 0; d++)
+	{
+		int64_t g = wanted - direction * d;
+		if (g >= 0 && g <= last && !find(g)) f = g;
+	}
+	if (f < 0) return -1;
+
+	// the lowest missing frame of the window in the same chunk comes first: the decoder only runs forward
+	int64_t k = reader.header.keyframe_interval, lo = std::max((f / k) * k, direction > 0 ? wanted - int64_t(behind) : wanted - int64_t(ahead));
+	for (int64_t g = lo; g < f; g++) if (!find(g)) return g;
+	return f;
+}
+
+inline void replay_player_t::run()
+{
+	size_t n = reader.body_count();
+	for (;;)
+	{
+		int64_t f;
+		replay_frame_t slot;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [&]() { return b_stop || (f = next_missing()) >= 0; });
+			if (b_stop) return;
+
+			// a free slot, or the one farthest from the playhead
+			replay_frame_t* victim = nullptr;
+			int64_t farthest = -1;
+			for (auto& c : cache)
+			{
+				if (c.index == REPLAY_LOADING) continue;
+				int64_t d = c.index < 0 ? INT64_MAX : std::abs(c.index - wanted);
+				if (d > farthest) { farthest = d; victim = &c; }
+			}
+			if (!victim) { cv.wait(lock); continue; }
+			std::swap(slot, *victim);
+			victim->index = REPLAY_LOADING;
+		}
+
+		for (float_array* a : { &slot.px, &slot.py, &slot.pz }) a->resize(n);
+		bool b_read = reader.read_frame(uint64_t(f), slot.px.data(), slot.py.data(), slot.pz.data());
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto& c : cache)
+			{
+				if (c.index != REPLAY_LOADING) continue;
+				slot.index = b_read ? f : -1;
+				std::swap(slot, c);
+				break;
+			}
+		}
+		if (!b_read) { printf("> failed to read frame %lld of the trajectory\n", (long long) f); return; }
+	}
+}
+
+inline void replay_player_t::request(int64_t f)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		wanted = f;
+		direction = rate < 0 ? -1 : 1;
+	}
+	cv.notify_all();
+}
+
+inline void replay_player_t::seek(double f)
+{
+	frame = std::min(std::max(f, 0.0), double(frame_count() - 1));
+	request(int64_t(frame));
+}
+
+inline void replay_player_t::set_rate(float r)
+{
+	float s = r < 0 ? -1.0f : 1.0f;
+	rate = s * std::min(std::max(fabsf(r), 1.0f / REPLAY_MAX_RATE), REPLAY_MAX_RATE);
+	request(int64_t(frame));
+}
+
+inline void replay_player_t::advance(float dt, body_store_t& b)
+{
+	double last = double(frame_count() - 1);
+	double next = std::min(std::max(frame + double(dt) * rate / reader.header.frame_dt, 0.0), last);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	int64_t f0 = int64_t(next);
+	const replay_frame_t *a = find(f0), *c = find(std::min(f0 + 1, int64_t(last)));
+	if (!a)
+	{
+		// hold the playhead on the frame shown until the I/O thread catches up
+		stalls++;
+		f0 = int64_t(frame);
+		a = find(f0);
+		c = find(std::min(f0 + 1, int64_t(last)));
+		if (!a) { wanted = f0; cv.notify_all(); return; }
+	}
+	else frame = next;
+
+	float w = c ? float(frame - double(f0)) : 0.0f, v = 1.0f - w;
+	if (!c) c = a;
+	shown = f0;
+	size_t n = b.size();
+	std::copy(a->px.begin(), a->px.begin() + n, b.px.begin());
+	std::copy(a->py.begin(), a->py.begin() + n, b.py.begin());
+	std::copy(a->pz.begin(), a->pz.begin() + n, b.pz.begin());
+	parallel_for(n, BODY_GRAIN, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			b.render[i].center_radius = vec4(a->px[i] * v + c->px[i] * w, a->py[i] * v + c->py[i] * w, a->pz[i] * v + c->pz[i] * w, float(b.radius[i]));
+	});
+
+	wanted = int64_t(frame);
+	direction = rate < 0 ? -1 : 1;
+	cv.notify_all();
+}
+
+#endif
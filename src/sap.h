@@ -0,0 +1,119 @@
+#pragma once
+#ifndef __SAP_H__
+#define __SAP_H__
+
+#include <algorithm>
+#include <vector>
+
+/*
+* Incremental sweep-and-prune broadphase
+* - interval endpoints [center-r, center+r] stay sorted between steps
+* - bodies move only a little per step, so insertion sort repairs the order in ~O(n); when the
+*   body count changed (or after clear()) the endpoints are sorted from scratch with std::sort,
+*   as insertion sort from body order is O(n^2)
+* - axes=1 keeps x sorted only; axes=3 keeps x/y/z sorted and sweeps the axis of largest spread
+*/
+struct endpoint_t
+{
+	real	value;
+	uint	id;		// (body index << 1) | is_max
+};
+
+struct sweep_and_prune_t
+{
+	int							axes = 3;		// # of maintained axes: 1 or 3
+	int							sweep_axis = 0;	// axis swept in the last step
+	std::vector<endpoint_t>		endpoints[3];	// sorted endpoints per axis
+	std::vector<uint>			active;			// bodies whose interval is open during the sweep
+	std::vector<uint>			active_slot;	// position of each body in active
+
+	// public functions
+	void	update( const body_store_t& bodies );
+	void	find_pairs( const body_store_t& bodies, std::vector<pair_t>& pairs );
+	void	clear() { for (auto& e : endpoints) e.clear(); }	// the bodies were replaced
+};
+
+inline void sweep_and_prune_t::update(const body_store_t& bodies)
+{
+	size_t n = bodies.size();
+	for (int a = 0; a < 3; a++)
+	{
+		std::vector<endpoint_t>& e = endpoints[a];
+		if (a >= axes) { e.clear(); continue; }
+
+		// refresh endpoint values in place; rebuild when the body count changed
+		bool b_rebuild = e.size() != n * 2;
+		if (b_rebuild)
+		{
+			e.resize(n * 2);
+			for (size_t i = 0; i < n * 2; i++) e[i].id = uint(i);
+		}
+		const real* pos = bodies.position(a);
+		for (auto& p : e)
+		{
+			uint i = p.id >> 1;
+			p.value = (p.id & 1) ? pos[i] + bodies.radius[i] : pos[i] - bodies.radius[i];
+		}
+
+		// ties by id, so the order does not depend on the sort
+		if (b_rebuild)
+		{
+			std::sort(e.begin(), e.end(), [](const endpoint_t& p, const endpoint_t& q) { return p.value < q.value || (p.value == q.value && p.id < q.id); });
+			continue;
+		}
+
+		// insertion sort: cheap when the previous order is nearly right
+		for (size_t i = 1; i < e.size(); i++)
+		{
+			endpoint_t p = e[i];
+			size_t j = i;
+			for (; j > 0 && e[j - 1].value > p.value; j--) e[j] = e[j - 1];
+			e[j] = p;
+		}
+	}
+
+	// sweep the axis with the largest spread of centers
+	sweep_axis = 0;
+	if (axes == 3 && n > 1)
+	{
+		real best = -1;
+		for (int a = 0; a < 3; a++)
+		{
+			const real* pos = bodies.position(a);
+			real mean = 0, var = 0;
+			for (size_t i = 0; i < n; i++) mean += pos[i];
+			mean /= real(n);
+			for (size_t i = 0; i < n; i++) { real d = pos[i] - mean; var += d * d; }
+			if (var > best) { best = var; sweep_axis = a; }
+		}
+	}
+}
+
+inline void sweep_and_prune_t::find_pairs(const body_store_t& bodies, std::vector<pair_t>& pairs)
+{
+	pairs.clear();
+	active.clear();
+	active_slot.resize(bodies.size());
+
+	for (auto& p : endpoints[sweep_axis])
+	{
+		uint i = p.id >> 1;
+		if (p.id & 1)
+		{	// max endpoint: close the interval
+			uint slot = active_slot[i];
+			active[slot] = active.back();
+			active_slot[active[slot]] = slot;
+			active.pop_back();
+		}
+		else
+		{	// min endpoint: every open interval overlaps on this axis
+			for (uint j : active)
+				if (aabb_overlap(bodies, i, j))
+					pairs.push_back(i < j ? pair_t{ i, j } : pair_t{ j, i });
+			active_slot[i] = uint(active.size());
+			active.push_back(i);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,157 @@
+#pragma once
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+/*
+* Thin wrapper over the widest available float SIMD registers
+* - AVX-512: 16 lanes, AVX2: 8 lanes, SSE2: 4 lanes, otherwise a 1-lane scalar fallback
+* - simdf: float lanes, simdm: lane mask, simd_bits(): one bit per lane
+* - simdd/simdmd: the same registers as double lanes (half as many), overloads of the same names
+* - simd_of<Real>: register, mask and lane count of a scalar type for the templated kernels
+* - named functions instead of operators, since gcc/clang vector types cannot be overloaded
+*/
+#if defined(__AVX512F__)
+	#include <immintrin.h>
+	#define SIMD_WIDTH 16
+	typedef __m512		simdf;
+	typedef __mmask16	simdm;
+	inline simdf	simd_set1( float v ) { return _mm512_set1_ps(v); }
+	inline simdf	simd_load( const float* p ) { return _mm512_loadu_ps(p); }
+	inline void		simd_store( float* p, simdf v ) { _mm512_storeu_ps(p, v); }
+	inline simdf	simd_add( simdf a, simdf b ) { return _mm512_add_ps(a, b); }
+	inline simdf	simd_sub( simdf a, simdf b ) { return _mm512_sub_ps(a, b); }
+	inline simdf	simd_mul( simdf a, simdf b ) { return _mm512_mul_ps(a, b); }
+	inline simdf	simd_div( simdf a, simdf b ) { return _mm512_div_ps(a, b); }
+	inline simdf	simd_sqrt( simdf a ) { return _mm512_maskz_sqrt_ps(__mmask16(0xFFFF), a); }
+	inline simdm	simd_lt( simdf a, simdf b ) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+	inline simdm	simd_le( simdf a, simdf b ) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+	inline simdm	simd_and( simdm a, simdm b ) { return simdm(a & b); }
+	inline simdf	simd_select( simdm m, simdf a, simdf b ) { return _mm512_mask_blend_ps(m, b, a); }
+	inline int		simd_bits( simdm m ) { return int(m); }
+
+	#define SIMD_WIDTH_D 8
+	typedef __m512d		simdd;
+	typedef __mmask8	simdmd;
+	inline simdd	simd_set1( double v ) { return _mm512_set1_pd(v); }
+	inline simdd	simd_load( const double* p ) { return _mm512_loadu_pd(p); }
+	inline void		simd_store( double* p, simdd v ) { _mm512_storeu_pd(p, v); }
+	inline simdd	simd_add( simdd a, simdd b ) { return _mm512_add_pd(a, b); }
+	inline simdd	simd_sub( simdd a, simdd b ) { return _mm512_sub_pd(a, b); }
+	inline simdd	simd_mul( simdd a, simdd b ) { return _mm512_mul_pd(a, b); }
+	inline simdd	simd_div( simdd a, simdd b ) { return _mm512_div_pd(a, b); }
+	inline simdd	simd_sqrt( simdd a ) { return _mm512_maskz_sqrt_pd(__mmask8(0xFF), a); }
+	inline simdmd	simd_lt( simdd a, simdd b ) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+	inline simdmd	simd_le( simdd a, simdd b ) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+	inline simdmd	simd_and( simdmd a, simdmd b ) { return simdmd(a & b); }
+	inline simdd	simd_select( simdmd m, simdd a, simdd b ) { return _mm512_mask_blend_pd(m, b, a); }
+	inline int		simd_bits( simdmd m ) { return int(m); }
+#elif defined(__AVX2__)
+	#include <immintrin.h>
+	#define SIMD_WIDTH 8
+	typedef __m256		simdf;
+	typedef __m256		simdm;
+	inline simdf	simd_set1( float v ) { return _mm256_set1_ps(v); }
+	inline simdf	simd_load( const float* p ) { return _mm256_loadu_ps(p); }
+	inline void		simd_store( float* p, simdf v ) { _mm256_storeu_ps(p, v); }
+	inline simdf	simd_add( simdf a, simdf b ) { return _mm256_add_ps(a, b); }
+	inline simdf	simd_sub( simdf a, simdf b ) { return _mm256_sub_ps(a, b); }
+	inline simdf	simd_mul( simdf a, simdf b ) { return _mm256_mul_ps(a, b); }
+	inline simdf	simd_div( simdf a, simdf b ) { return _mm256_div_ps(a, b); }
+	inline simdf	simd_sqrt( simdf a ) { return _mm256_sqrt_ps(a); }
+	inline simdm	simd_lt( simdf a, simdf b ) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	inline simdm	simd_le( simdf a, simdf b ) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	inline simdm	simd_and( simdm a, simdm b ) { return _mm256_and_ps(a, b); }
+	inline simdf	simd_select( simdm m, simdf a, simdf b ) { return _mm256_blendv_ps(b, a, m); }
+	inline int		simd_bits( simdm m ) { return _mm256_movemask_ps(m); }
+
+	#define SIMD_WIDTH_D 4
+	typedef __m256d		simdd;
+	typedef __m256d		simdmd;
+	inline simdd	simd_set1( double v ) { return _mm256_set1_pd(v); }
+	inline simdd	simd_load( const double* p ) { return _mm256_loadu_pd(p); }
+	inline void		simd_store( double* p, simdd v ) { _mm256_storeu_pd(p, v); }
+	inline simdd	simd_add( simdd a, simdd b ) { return _mm256_add_pd(a, b); }
+	inline simdd	simd_sub( simdd a, simdd b ) { return _mm256_sub_pd(a, b); }
+	inline simdd	simd_mul( simdd a, simdd b ) { return _mm256_mul_pd(a, b); }
+	inline simdd	simd_div( simdd a, simdd b ) { return _mm256_div_pd(a, b); }
+	inline simdd	simd_sqrt( simdd a ) { return _mm256_sqrt_pd(a); }
+	inline simdmd	simd_lt( simdd a, simdd b ) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+	inline simdmd	simd_le( simdd a, simdd b ) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+	inline simdmd	simd_and( simdmd a, simdmd b ) { return _mm256_and_pd(a, b); }
+	inline simdd	simd_select( simdmd m, simdd a, simdd b ) { return _mm256_blendv_pd(b, a, m); }
+	inline int		simd_bits( simdmd m ) { return _mm256_movemask_pd(m); }
+#elif defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define SIMD_WIDTH 4
+	typedef __m128		simdf;
+	typedef __m128		simdm;
+	inline simdf	simd_set1( float v ) { return _mm_set1_ps(v); }
+	inline simdf	simd_load( const float* p ) { return _mm_loadu_ps(p); }
+	inline void		simd_store( float* p, simdf v ) { _mm_storeu_ps(p, v); }
+	inline simdf	simd_add( simdf a, simdf b ) { return _mm_add_ps(a, b); }
+	inline simdf	simd_sub( simdf a, simdf b ) { return _mm_sub_ps(a, b); }
+	inline simdf	simd_mul( simdf a, simdf b ) { return _mm_mul_ps(a, b); }
+	inline simdf	simd_div( simdf a, simdf b ) { return _mm_div_ps(a, b); }
+	inline simdf	simd_sqrt( simdf a ) { return _mm_sqrt_ps(a); }
+	inline simdm	simd_lt( simdf a, simdf b ) { return _mm_cmplt_ps(a, b); }
+	inline simdm	simd_le( simdf a, simdf b ) { return _mm_cmple_ps(a, b); }
+	inline simdm	simd_and( simdm a, simdm b ) { return _mm_and_ps(a, b); }
+	inline simdf	simd_select( simdm m, simdf a, simdf b ) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+	inline int		simd_bits( simdm m ) { return _mm_movemask_ps(m); }
+
+	#define SIMD_WIDTH_D 2
+	typedef __m128d		simdd;
+	typedef __m128d		simdmd;
+	inline simdd	simd_set1( double v ) { return _mm_set1_pd(v); }
+	inline simdd	simd_load( const double* p ) { return _mm_loadu_pd(p); }
+	inline void		simd_store( double* p, simdd v ) { _mm_storeu_pd(p, v); }
+	inline simdd	simd_add( simdd a, simdd b ) { return _mm_add_pd(a, b); }
+	inline simdd	simd_sub( simdd a, simdd b ) { return _mm_sub_pd(a, b); }
+	inline simdd	simd_mul( simdd a, simdd b ) { return _mm_mul_pd(a, b); }
+	inline simdd	simd_div( simdd a, simdd b ) { return _mm_div_pd(a, b); }
+	inline simdd	simd_sqrt( simdd a ) { return _mm_sqrt_pd(a); }
+	inline simdmd	simd_lt( simdd a, simdd b ) { return _mm_cmplt_pd(a, b); }
+	inline simdmd	simd_le( simdd a, simdd b ) { return _mm_cmple_pd(a, b); }
+	inline simdmd	simd_and( simdmd a, simdmd b ) { return _mm_and_pd(a, b); }
+	inline simdd	simd_select( simdmd m, simdd a, simdd b ) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+	inline int		simd_bits( simdmd m ) { return _mm_movemask_pd(m); }
+#else
+	#define SIMD_WIDTH 1
+	typedef float		simdf;
+	typedef bool		simdm;
+	inline simdf	simd_set1( float v ) { return v; }
+	inline simdf	simd_load( const float* p ) { return *p; }
+	inline void		simd_store( float* p, simdf v ) { *p = v; }
+	inline simdf	simd_add( simdf a, simdf b ) { return a + b; }
+	inline simdf	simd_sub( simdf a, simdf b ) { return a - b; }
+	inline simdf	simd_mul( simdf a, simdf b ) { return a * b; }
+	inline simdf	simd_div( simdf a, simdf b ) { return a / b; }
+	inline simdf	simd_sqrt( simdf a ) { return sqrtf(a); }
+	inline simdm	simd_lt( simdf a, simdf b ) { return a < b; }
+	inline simdm	simd_le( simdf a, simdf b ) { return a <= b; }
+	inline simdm	simd_and( simdm a, simdm b ) { return a && b; }
+	inline simdf	simd_select( simdm m, simdf a, simdf b ) { return m ? a : b; }
+	inline int		simd_bits( simdm m ) { return m ? 1 : 0; }
+
+	#define SIMD_WIDTH_D 1
+	typedef double		simdd;
+	typedef bool		simdmd;
+	inline simdd	simd_set1( double v ) { return v; }
+	inline simdd	simd_load( const double* p ) { return *p; }
+	inline void		simd_store( double* p, simdd v ) { *p = v; }
+	inline simdd	simd_add( simdd a, simdd b ) { return a + b; }
+	inline simdd	simd_sub( simdd a, simdd b ) { return a - b; }
+	inline simdd	simd_mul( simdd a, simdd b ) { return a * b; }
+	inline simdd	simd_div( simdd a, simdd b ) { return a / b; }
+	inline simdd	simd_sqrt( simdd a ) { return sqrt(a); }
+	inline simdmd	simd_lt( simdd a, simdd b ) { return a < b; }
+	inline simdmd	simd_le( simdd a, simdd b ) { return a <= b; }
+	inline simdd	simd_select( simdmd m, simdd a, simdd b ) { return m ? a : b; }
+	// simd_and() and simd_bits() of bool masks are shared with float
+#endif
+
+template <typename Real> struct simd_of;
+template <> struct simd_of<float> { typedef simdf type; typedef simdm mask; static const int width = SIMD_WIDTH; };
+template <> struct simd_of<double> { typedef simdd type; typedef simdmd mask; static const int width = SIMD_WIDTH_D; };
+
+#endif
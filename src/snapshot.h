@@ -0,0 +1,313 @@
+#pragma once
+#ifndef __SNAPSHOT_H__
+#define __SNAPSHOT_H__
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#ifndef WIN32_LEAN_AND_MEAN
+		#define WIN32_LEAN_AND_MEAN
+	#endif
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+/*
+* Binary snapshot of the simulation state
+* - a fixed header followed by one section per body array (px py pz vx vy vz radius inv_mass
+*   tex_idx) and the wall planes; every section starts at a multiple of SNAPSHOT_ALIGN, so a
+*   mapped file (page aligned) can be read in place with aligned SIMD loads
+* - loading maps the file and checks the header only: the arrays are used as they are
+*   (snapshot_view_t), or copied into a body_store_t (load_snapshot)
+* - native byte order; version is bumped whenever the layout changes; the body arrays hold
+*   real (see body.h), and a build of the other precision refuses the file
+* - snapshot_writer_t copies the state into its image on the caller's thread (one memcpy
+*   per array) and writes the file on its own thread, so stepping goes on while it writes;
+*   the file is written under a temporary name and renamed when complete
+*/
+static const char		SNAPSHOT_MAGIC[8] = { 'C', 'G', 'S', 'N', 'A', 'P', '\r', '\n' };
+static const uint32_t	SNAPSHOT_VERSION = 2;
+static const uint64_t	SNAPSHOT_ALIGN = 64;	// section alignment (cache line, AVX-512 width)
+
+enum snapshot_section
+{
+	SNAPSHOT_PX = 0, SNAPSHOT_PY, SNAPSHOT_PZ,
+	SNAPSHOT_VX, SNAPSHOT_VY, SNAPSHOT_VZ,
+	SNAPSHOT_RADIUS, SNAPSHOT_INV_MASS,
+	SNAPSHOT_TEX_IDX,		// int32 per body
+	SNAPSHOT_PLANES,		// plane_t per wall
+	SNAPSHOT_SECTION_COUNT
+};
+
+// simulation state outside the body arrays
+struct snapshot_info_t
+{
+	double		time = 0.0;			// simulated time
+	uint64_t	step_count = 0;
+	uint64_t	seed = DEFAULT_SEED;	// scene seed
+	rng_t		rng;				// spawn generator state after spawning
+};
+
+struct snapshot_header_t
+{
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	header_size;		// sizeof(snapshot_header_t)
+	uint64_t	file_size;
+	uint64_t	body_count;
+	uint64_t	plane_count;
+	double		time;
+	uint64_t	step_count;
+	uint64_t	seed;
+	uint64_t	rng_state, rng_inc;
+	uint64_t	offset[SNAPSHOT_SECTION_COUNT];	// from the start of the file
+	uint32_t	real_size;			// bytes per element of the body arrays
+	uint32_t	reserved0;
+	uint64_t	reserved[2];
+};
+
+inline uint64_t snapshot_section_size(snapshot_section s, uint64_t bodies, uint64_t planes)
+{
+	return s == SNAPSHOT_PLANES ? planes * sizeof(plane_t) : s == SNAPSHOT_TEX_IDX ? bodies * sizeof(int32_t) : bodies * sizeof(real);
+}
+
+// offsets of the sections; returns the file size
+inline uint64_t snapshot_layout(snapshot_header_t& h, uint64_t bodies, uint64_t planes)
+{
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+	h.version = SNAPSHOT_VERSION;
+	h.header_size = uint32_t(sizeof(h));
+	h.real_size = uint32_t(sizeof(real));
+	h.body_count = bodies;
+	h.plane_count = planes;
+	uint64_t at = sizeof(h);
+	for (int s = 0; s < SNAPSHOT_SECTION_COUNT; s++)
+	{
+		at = (at + SNAPSHOT_ALIGN - 1) / SNAPSHOT_ALIGN * SNAPSHOT_ALIGN;
+		h.offset[s] = at;
+		at += snapshot_section_size(snapshot_section(s), bodies, planes);
+	}
+	return h.file_size = at;
+}
+
+//*************************************
+// read-only mapping of a snapshot file
+struct snapshot_view_t
+{
+	const uint8_t*	data = nullptr;
+	uint64_t		size = 0;
+#ifdef _WIN32
+	HANDLE			file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#endif
+
+	snapshot_view_t() = default;
+	snapshot_view_t( const snapshot_view_t& ) = delete;
+	snapshot_view_t& operator=( const snapshot_view_t& ) = delete;
+	~snapshot_view_t() { close(); }
+
+	// public functions
+	bool	open( const char* path );
+	void	close();
+	const snapshot_header_t& header() const { return *reinterpret_cast<const snapshot_header_t*>(data); }
+	size_t	body_count() const { return size_t(header().body_count); }
+	const real*		array( snapshot_section s ) const { return reinterpret_cast<const real*>(data + header().offset[s]); }
+	const int32_t*	tex_idx() const { return reinterpret_cast<const int32_t*>(data + header().offset[SNAPSHOT_TEX_IDX]); }
+	const plane_t*	planes() const { return reinterpret_cast<const plane_t*>(data + header().offset[SNAPSHOT_PLANES]); }
+
+	// internal functions
+	bool	validate() const;
+};
+
+inline bool snapshot_view_t::validate() const
+{
+	if (size < sizeof(snapshot_header_t)) return false;
+	const snapshot_header_t& h = header();
+	if (memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic)) != 0 || h.version != SNAPSHOT_VERSION || h.header_size != sizeof(h) || h.file_size != size) return false;
+	for (int s = 0; s < SNAPSHOT_SECTION_COUNT; s++)
+	{
+		uint64_t bytes = snapshot_section_size(snapshot_section(s), h.body_count, h.plane_count);
+		if (h.offset[s] % SNAPSHOT_ALIGN || h.offset[s] < sizeof(h) || h.offset[s] > size || bytes > size - h.offset[s]) return false;
+	}
+	return true;
+}
+
+inline bool snapshot_view_t::open(const char* path)
+{
+	close();
+#ifdef _WIN32
+	file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) { printf("Failed to open %s\n", path); return false; }
+	LARGE_INTEGER n;
+	if (!GetFileSizeEx(file, &n) || n.QuadPart == 0) { close(); printf("%s is empty\n", path); return false; }
+	size = uint64_t(n.QuadPart);
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping) data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0) { printf("Failed to open %s\n", path); return false; }
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) { ::close(fd); printf("%s is empty\n", path); return false; }
+	size = uint64_t(st.st_size);
+	void* p = mmap(nullptr, size_t(size), PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (p != MAP_FAILED) data = static_cast<const uint8_t*>(p);
+#endif
+	if (!data) { close(); printf("Failed to map %s\n", path); return false; }
+	if (!validate()) { close(); printf("%s is not a version %u snapshot\n", path, SNAPSHOT_VERSION); return false; }
+	if (header().real_size != sizeof(real)) { printf("%s holds %u-byte reals, this build %u-byte\n", path, header().real_size, uint(sizeof(real))); close(); return false; }
+	return true;
+}
+
+inline void snapshot_view_t::close()
+{
+#ifdef _WIN32
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	mapping = nullptr;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (data) munmap(const_cast<uint8_t*>(data), size_t(size));
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+//*************************************
+// copies a mapped snapshot into the body store; walls keep their geometry when the count
+// matches, otherwise they become bare planes
+inline void load_snapshot(const snapshot_view_t& v, body_store_t& b, std::vector<wall_t>& walls, snapshot_info_t& info)
+{
+	const snapshot_header_t& h = v.header();
+	size_t n = v.body_count();
+	real_array* arrays[] = { &b.px, &b.py, &b.pz, &b.vx, &b.vy, &b.vz, &b.radius, &b.inv_mass };
+	for (int s = 0; s <= SNAPSHOT_INV_MASS; s++) arrays[s]->resize(n);
+	b.render.resize(n);
+	parallel_for(n, 1 << 16, [&](size_t begin, size_t end)
+	{
+		for (int s = 0; s <= SNAPSHOT_INV_MASS; s++) memcpy(arrays[s]->data() + begin, v.array(snapshot_section(s)) + begin, (end - begin) * sizeof(real));
+		const int32_t* tex = v.tex_idx();
+		for (size_t i = begin; i < end; i++)
+		{
+			render_body_t& r = b.render[i];
+			r = render_body_t();
+			r.tex_idx = tex[i];
+			r.center_radius = vec4(float(b.px[i]), float(b.py[i]), float(b.pz[i]), float(b.radius[i]));
+		}
+	});
+
+	if (walls.size() != h.plane_count) walls.assign(size_t(h.plane_count), wall_t());
+	const plane_t* planes = v.planes();
+	for (size_t k = 0; k < walls.size(); k++)
+	{
+		walls[k].normal = vec3(planes[k].nx, planes[k].ny, planes[k].nz);
+		walls[k].dist = planes[k].dist;
+	}
+
+	info.time = h.time;
+	info.step_count = h.step_count;
+	info.seed = h.seed;
+	info.rng.state = h.rng_state;
+	info.rng.inc = h.rng_inc;
+}
+
+inline bool load_snapshot(const char* path, body_store_t& b, std::vector<wall_t>& walls, snapshot_info_t& info)
+{
+	snapshot_view_t v;
+	if (!v.open(path)) return false;
+	load_snapshot(v, b, walls, info);
+	return true;
+}
+
+//*************************************
+// background snapshot writer
+struct snapshot_writer_t
+{
+	std::vector<uint64_t>	image;			// the whole file, 8-byte aligned
+	std::string				path;
+	std::thread				worker;
+	std::atomic<bool>		busy{ false };
+	std::atomic<bool>		failed{ false };	// the last write failed
+
+	snapshot_writer_t() = default;
+	snapshot_writer_t( const snapshot_writer_t& ) = delete;
+	snapshot_writer_t& operator=( const snapshot_writer_t& ) = delete;
+	~snapshot_writer_t() { wait(); }
+
+	// public functions
+	bool	save( const char* path, const body_store_t& bodies, const std::vector<wall_t>& walls, const snapshot_info_t& info );	// false: the previous save is still writing
+	void	wait() { if (worker.joinable()) worker.join(); }
+
+	// internal functions
+	void	write();
+};
+
+inline bool snapshot_writer_t::save(const char* file_path, const body_store_t& b, const std::vector<wall_t>& walls, const snapshot_info_t& info)
+{
+	if (busy) return false;
+	wait();
+
+	snapshot_header_t h;
+	size_t n = b.size();
+	uint64_t size = snapshot_layout(h, n, walls.size());
+	h.time = info.time;
+	h.step_count = info.step_count;
+	h.seed = info.seed;
+	h.rng_state = info.rng.state;
+	h.rng_inc = info.rng.inc;
+
+	image.resize(size_t((size + 7) / 8));
+	uint8_t* data = reinterpret_cast<uint8_t*>(image.data());
+	memcpy(data, &h, sizeof(h));
+	for (int s = 0; s < SNAPSHOT_SECTION_COUNT; s++)	// zero the padding so equal states give equal files
+	{
+		uint64_t end = s ? h.offset[s - 1] + snapshot_section_size(snapshot_section(s - 1), n, walls.size()) : sizeof(h);
+		memset(data + end, 0, size_t(h.offset[s] - end));
+	}
+	const real_array* arrays[] = { &b.px, &b.py, &b.pz, &b.vx, &b.vy, &b.vz, &b.radius, &b.inv_mass };
+	parallel_for(n, 1 << 16, [&](size_t begin, size_t end)
+	{
+		for (int s = 0; s <= SNAPSHOT_INV_MASS; s++) memcpy(data + h.offset[s] + begin * sizeof(real), arrays[s]->data() + begin, (end - begin) * sizeof(real));
+		int32_t* tex = reinterpret_cast<int32_t*>(data + h.offset[SNAPSHOT_TEX_IDX]);
+		for (size_t i = begin; i < end; i++) tex[i] = b.render[i].tex_idx;
+	});
+	plane_t* planes = reinterpret_cast<plane_t*>(data + h.offset[SNAPSHOT_PLANES]);
+	for (size_t k = 0; k < walls.size(); k++) planes[k] = plane_t{ walls[k].normal.x, walls[k].normal.y, walls[k].normal.z, walls[k].dist };
+
+	path = file_path;
+	busy = true;
+	worker = std::thread([this]() { write(); });
+	return true;
+}
+
+inline void snapshot_writer_t::write()
+{
+	const snapshot_header_t* h = reinterpret_cast<const snapshot_header_t*>(image.data());
+	std::string tmp = path + ".tmp";
+	FILE* fp = fopen(tmp.c_str(), "wb");
+	bool ok = fp && fwrite(image.data(), 1, size_t(h->file_size), fp) == size_t(h->file_size);
+	if (fp) ok = fclose(fp) == 0 && ok;
+	if (ok)
+	{
+		std::remove(path.c_str());
+		ok = std::rename(tmp.c_str(), path.c_str()) == 0;
+	}
+	if (!ok) printf("Failed to write %s\n", path.c_str());
+	failed = !ok;
+	busy = false;
+}
+
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+#ifndef __SOLVER_H__
+#define __SOLVER_H__
+
+#include <cstdint>
+#include <vector>
+
+/*
+* Parallel contact solver by graph coloring
+* - the candidates are tested for overlap in parallel and compacted in candidate order;
+*   the impulses change only velocities, so the batches resolve these contacts untested
+* - overlapping pairs are greedily colored in pair order so that no two pairs
+*   of one color share a body; each color is a batch solved concurrently
+* - a body may belong to at most MAX_COLORS batches; the remaining pairs go to
+*   a last batch solved on one thread
+* - batches are solved in color order and pairs inside a batch never conflict,
+*   so the result is the same for any thread count
+*/
+static const uint MAX_COLORS = 64;
+static const size_t SOLVER_GRAIN = 256;	// min pairs per thread
+
+struct contact_batches_t
+{
+	std::vector<pair_t>		pairs;			// overlapping pairs sorted by color
+	std::vector<uint>		color_start;	// color c: pairs[color_start[c]] ~ pairs[color_start[c+1]]
+	std::vector<uint64_t>	body_colors;	// colors used by each body
+	std::vector<uint>		color_of;		// color of each overlapping pair, MAX_COLORS = overflow
+	std::vector<pair_t>		contacts;		// overlapping pairs in candidate order
+	std::vector<uint8_t>	overlap;		// overlap test of each candidate
+
+	// public functions
+	void	build( const body_store_t& bodies, const std::vector<pair_t>& candidates, size_t align = 1 );
+	uint	colors() const { return uint(color_start.size()) - 1; }
+};
+
+inline void contact_batches_t::build(const body_store_t& bodies, const std::vector<pair_t>& candidates, size_t align)
+{
+	overlap.resize(candidates.size());
+	parallel_for(candidates.size(), SOLVER_GRAIN, [&](size_t b, size_t e)
+	{
+		for (size_t k = b; k < e; k++) overlap[k] = is_collide(bodies, candidates[k].a, candidates[k].b);
+	}, align);
+	contacts.clear();
+	for (size_t k = 0; k < candidates.size(); k++)
+		if (overlap[k]) contacts.push_back(candidates[k]);
+
+	// greedy coloring: lowest color free on both bodies
+	body_colors.assign(bodies.size(), 0);
+	color_of.resize(contacts.size());
+	std::vector<uint> count(MAX_COLORS + 1, 0);
+	uint used = 0;
+	for (size_t k = 0; k < contacts.size(); k++)
+	{
+		uint64_t busy = body_colors[contacts[k].a] | body_colors[contacts[k].b];
+		uint c = 0;
+		while (c < MAX_COLORS && (busy >> c & 1)) c++;
+		if (c < MAX_COLORS)
+		{
+			body_colors[contacts[k].a] |= uint64_t(1) << c;
+			body_colors[contacts[k].b] |= uint64_t(1) << c;
+		}
+		color_of[k] = c;
+		count[c]++;
+		used = std::max(used, c + 1);
+	}
+
+	// counting sort by color, keeping pair order inside a color
+	color_start.assign(used + 1, 0);
+	for (uint c = 0; c < used; c++) color_start[c + 1] = color_start[c] + count[c];
+	pairs.resize(contacts.size());
+	std::vector<uint> cursor(color_start.begin(), color_start.end() - 1);
+	for (size_t k = 0; k < contacts.size(); k++) pairs[cursor[color_of[k]]++] = contacts[k];
+}
+
+// returns the number of overlapping pairs
+inline size_t solve_contacts_parallel(body_store_t& bodies, const std::vector<pair_t>& candidates, contact_batches_t& batches, size_t align = 1)
+{
+	batches.build(bodies, candidates, align);
+	for (uint c = 0; c < batches.colors(); c++)
+	{
+		const pair_t* p = batches.pairs.data() + batches.color_start[c];
+		size_t n = batches.color_start[c + 1] - batches.color_start[c];
+		auto resolve = [&](size_t b, size_t e) { for (size_t k = b; k < e; k++) resolve_elastic(bodies, p[k].a, p[k].b); };
+		if (c == MAX_COLORS) { resolve(0, n); continue; }	// overflow: may conflict
+		parallel_for(n, SOLVER_GRAIN, resolve, align);
+	}
+	return batches.contacts.size();
+}
+
+#endif
@@ -0,0 +1,194 @@
+#pragma once
+#ifndef __SPAWN_H__
+#define __SPAWN_H__
+
+#include <cmath>
+#include <vector>
+
+/*
+* Non-overlapping sphere spawner
+* - SPAWN_POISSON: dart throwing (Poisson-disk sampling with variable radii); a dart is tested
+*   only against the spheres of the 27 grid cells around it, cell edge = largest diameter;
+*   it stops after count * attempts darts, or when less than 1 / attempts of the recent darts
+*   were accepted (the region is saturated)
+* - SPAWN_LATTICE: one sphere per lattice site, jittered inside its own cell, so no test is
+*   needed; the sites used are spread evenly over the lattice
+* - radii are uniform in [min_radius, max_radius], or power law p(r) ~ r^-exponent
+*   (many small, few large)
+* - the whole sphere is inside [lo, hi]; fewer spheres than requested are placed when the
+*   region is full, and the number placed is returned
+*/
+static const uint SPAWN_ATTEMPTS = 30;			// darts per requested sphere
+static const uint SPAWN_WINDOW = 4096;			// darts between saturation checks
+static const uint SPAWN_CELLS_PER_BODY = 4;		// upper bound of (# of cells) / (# of bodies)
+static const float SPAWN_FILL = 0.9f;			// largest diameter / lattice spacing in fit_radii()
+
+enum spawn_mode { SPAWN_POISSON = 0, SPAWN_LATTICE, SPAWN_MODE_COUNT };
+enum radius_dist { RADIUS_UNIFORM = 0, RADIUS_POWER };
+
+static const char* SPAWN_NAME[SPAWN_MODE_COUNT] = { "poisson", "lattice" };
+
+struct spawn_params_t
+{
+	uint		count = 1;
+	vec3		lo = vec3(0), hi = vec3(1);		// region holding whole spheres
+	float		min_radius = 10.0f;
+	float		max_radius = 80.0f;
+	radius_dist	dist = RADIUS_UNIFORM;
+	float		exponent = 3.0f;				// RADIUS_POWER
+	float		max_speed = 30.0f;				// velocity components in [-max_speed, max_speed)
+	vec4		color = vec4(0.5f, 1.0f, 1.0f, 1.0f);
+	spawn_mode	mode = SPAWN_POISSON;
+	uint		attempts = SPAWN_ATTEMPTS;		// SPAWN_POISSON
+	uint64_t	seed = DEFAULT_SEED;
+};
+
+inline float spawn_radius(const spawn_params_t& p, rng_t& rng)
+{
+	float u = rng.randf(0.0f, 1.0f);
+	if (p.dist == RADIUS_UNIFORM || p.min_radius >= p.max_radius) return p.min_radius + (p.max_radius - p.min_radius) * u;
+
+	// inverse CDF of r^-exponent on [min_radius, max_radius]
+	if (fabsf(p.exponent - 1.0f) < 1e-6f) return p.min_radius * powf(p.max_radius / p.min_radius, u);
+	float e = 1.0f - p.exponent, a = powf(p.min_radius, e), b = powf(p.max_radius, e);
+	return std::min(std::max(powf(a + (b - a) * u, 1.0f / e), p.min_radius), p.max_radius);
+}
+
+// shrinks the radius range (keeping its ratio) so that count spheres of max_radius fit a lattice
+inline void fit_radii(spawn_params_t& p)
+{
+	vec3 extent = p.hi - p.lo;
+	float spacing = cbrtf(extent.x * extent.y * extent.z / float(std::max(p.count, 1u)));
+	float scale = SPAWN_FILL * spacing / (2.0f * p.max_radius);
+	if (scale >= 1.0f) return;
+	p.min_radius *= scale;
+	p.max_radius *= scale;
+}
+
+inline void spawn_body(body_store_t& bodies, const spawn_params_t& p, vec3 c, float r, rng_t& rng)
+{
+	sphere_t s;
+	s.center = c;
+	s.radius = r;
+	s.velocity = rng.randf3(-p.max_speed, p.max_speed);
+	s.color = p.color;
+	s.tex_idx = int(bodies.size());
+	bodies.add(s);
+}
+
+inline uint spawn_lattice(body_store_t& bodies, const spawn_params_t& p, rng_t& rng)
+{
+	vec3 extent = p.hi - p.lo;
+	float diameter = 2.0f * p.max_radius;
+	if (p.count == 0 || extent.x < diameter || extent.y < diameter || extent.z < diameter) return 0;
+
+	// largest spacing with enough sites, but not below the largest diameter
+	int dim[3];
+	float spacing = std::max(cbrtf(extent.x * extent.y * extent.z / float(p.count)), diameter);
+	for (;; spacing = std::max(spacing * 0.99f, diameter))
+	{
+		for (int k = 0; k < 3; k++) dim[k] = std::max(1, int((&extent.x)[k] / spacing));
+		if (size_t(dim[0]) * dim[1] * dim[2] >= p.count || spacing == diameter) break;
+	}
+	size_t sites = size_t(dim[0]) * dim[1] * dim[2];
+	uint n = uint(std::min(sites, size_t(p.count)));
+	vec3 cell = vec3(extent.x / dim[0], extent.y / dim[1], extent.z / dim[2]);
+
+	bodies.reserve(bodies.size() + n);
+	for (uint k = 0; k < n; k++)
+	{
+		size_t site = size_t(k) * sites / n;
+		int x = int(site % dim[0]), y = int(site / dim[0] % dim[1]), z = int(site / dim[0] / dim[1]);
+		float r = spawn_radius(p, rng);
+		vec3 c = p.lo + vec3((x + 0.5f) * cell.x, (y + 0.5f) * cell.y, (z + 0.5f) * cell.z);
+		vec3 slack = cell * 0.5f - vec3(r);
+		float jx = rng.randf(-slack.x, slack.x), jy = rng.randf(-slack.y, slack.y);
+		c += vec3(jx, jy, rng.randf(-slack.z, slack.z));
+		spawn_body(bodies, p, c, r, rng);
+	}
+	return n;
+}
+
+inline uint spawn_poisson(body_store_t& bodies, const spawn_params_t& p, rng_t& rng)
+{
+	vec3 extent = p.hi - p.lo;
+	float diameter = 2.0f * p.max_radius;
+	if (p.count == 0 || extent.x < 2.0f * p.min_radius || extent.y < 2.0f * p.min_radius || extent.z < 2.0f * p.min_radius) return 0;
+
+	// cell edge >= largest diameter; grow it if a sparse request would allocate too many cells
+	float cell_size = std::max(diameter, 1e-3f);
+	int dim[3];
+	for (size_t max_cells = SPAWN_CELLS_PER_BODY * size_t(p.count) + 64;; cell_size *= 2.0f)
+	{
+		for (int k = 0; k < 3; k++) dim[k] = std::max(1, int((&extent.x)[k] / cell_size) + 1);
+		if (size_t(dim[0]) * dim[1] * dim[2] <= max_cells) break;
+	}
+
+	// spheres of a cell as a linked list; cx..cr: accepted spheres
+	std::vector<int> head(size_t(dim[0]) * dim[1] * dim[2], -1), next;
+	std::vector<float> cx, cy, cz, cr;
+	next.reserve(p.count); cx.reserve(p.count); cy.reserve(p.count); cz.reserve(p.count); cr.reserve(p.count);
+
+	// stratified darts: a pass throws one dart per cell in memory order, or spreads the missing
+	// spheres evenly over the cells from a random offset; a dart outside [lo+r, hi-r] is
+	// dropped so that the density stays uniform
+	size_t cells = head.size();
+	uint placed = 0, window_placed = 0;
+	size_t window_dart = 0;
+	for (size_t dart = 0, darts = size_t(p.count) * p.attempts; dart < darts && placed < p.count;)
+	{
+		size_t m = std::min(cells, size_t(p.count - placed)), offset = m < cells ? rng.next() % cells : 0;
+		for (size_t d = 0; d < m && dart < darts && placed < p.count; d++, dart++)
+		{
+			size_t cell = (d * cells / m + offset) % cells;
+			int c[3] = { int(cell % dim[0]), int(cell / dim[0] % dim[1]), int(cell / dim[0] / dim[1]) };
+			float r = spawn_radius(p, rng);
+			float x = p.lo.x + (c[0] + rng.randf(0.0f, 1.0f)) * cell_size;
+			float y = p.lo.y + (c[1] + rng.randf(0.0f, 1.0f)) * cell_size;
+			float z = p.lo.z + (c[2] + rng.randf(0.0f, 1.0f)) * cell_size;
+			if (x < p.lo.x + r || x > p.hi.x - r || y < p.lo.y + r || y > p.hi.y - r || z < p.lo.z + r || z > p.hi.z - r) continue;
+
+			bool overlap = false;
+			for (int k = std::max(c[2] - 1, 0); k <= std::min(c[2] + 1, dim[2] - 1) && !overlap; k++)
+			for (int j = std::max(c[1] - 1, 0); j <= std::min(c[1] + 1, dim[1] - 1) && !overlap; j++)
+			for (int i = std::max(c[0] - 1, 0); i <= std::min(c[0] + 1, dim[0] - 1) && !overlap; i++)
+			{
+				for (int s = head[(size_t(k) * dim[1] + j) * dim[0] + i]; s >= 0; s = next[s])
+				{
+					float dx = x - cx[s], dy = y - cy[s], dz = z - cz[s], rs = r + cr[s];
+					if (dx * dx + dy * dy + dz * dz < rs * rs) { overlap = true; break; }
+				}
+			}
+			if (overlap) continue;
+
+			next.push_back(head[cell]);
+			head[cell] = int(placed++);
+			cx.push_back(x); cy.push_back(y); cz.push_back(z); cr.push_back(r);
+		}
+
+		// saturated: below 1/attempts acceptance since the last check
+		if (dart - window_dart < SPAWN_WINDOW) continue;
+		if (size_t(placed - window_placed) * p.attempts < dart - window_dart) break;
+		window_dart = dart;
+		window_placed = placed;
+	}
+
+	bodies.reserve(bodies.size() + placed);
+	for (uint s = 0; s < placed; s++) spawn_body(bodies, p, vec3(cx[s], cy[s], cz[s]), cr[s], rng);
+	return placed;
+}
+
+// appends up to p.count spheres to bodies drawing from rng, which is left past the last draw; returns the number placed
+inline uint spawn_spheres(body_store_t& bodies, const spawn_params_t& p, rng_t& rng)
+{
+	return p.mode == SPAWN_LATTICE ? spawn_lattice(bodies, p, rng) : spawn_poisson(bodies, p, rng);
+}
+
+// same, from a generator seeded with p.seed
+inline uint spawn_spheres(body_store_t& bodies, const spawn_params_t& p)
+{
+	rng_t rng(p.seed);
+	return spawn_spheres(bodies, p, rng);
+}
+
+#endif
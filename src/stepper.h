@@ -0,0 +1,109 @@
+#pragma once
+#ifndef __STEPPER_H__
+#define __STEPPER_H__
+
+#include <atomic>
+#include <cmath>
+
+/*
+* Fixed-timestep driver decoupled from the frame rate
+* - frame time is accumulated and consumed in fixed physics steps (PHYSICS_HZ)
+* - at most max_substeps per frame; time beyond the backlog cap is dropped and
+*   counted in dropped_time instead of vanishing silently
+* - the renderer interpolates between the states the physics thread publishes (see handoff.h)
+* - b_adaptive: each frame is split instead into the fewest equal substeps that keep
+*   |v|*dt/r of every body under cfl (max |v|/r is a parallel reduction once per frame);
+*   a calm scene takes one step per frame, and the state lands on the frame time; a frame
+*   longer than MAX_DT, or one that would need more than max_substeps, is slowed down and
+*   the rest counted in dropped_time
+*/
+static const float	PHYSICS_HZ = 240.0f;
+static const int	MAX_SUBSTEPS = 16;	// 15 fps still runs in real time
+static const float	CFL_LIMIT = 1.0f;	// |v|*dt/r of an adaptive substep: no body moves more than its radius
+
+struct fixed_stepper_t
+{
+	float		step = 1.0f / PHYSICS_HZ;	// physics timestep
+	int			max_substeps = MAX_SUBSTEPS;	// per frame
+	double		accumulator = 0.0;			// frame time not simulated yet
+	double		time = 0.0;					// simulated time
+	double		dropped_time = 0.0;			// frame time discarded by the backlog cap
+	int			substeps = 0;				// physics steps taken in the last frame
+
+	// adaptive substepping
+	bool		b_adaptive = false;
+	float		cfl = CFL_LIMIT;			// bound of |v|*dt/r per substep
+	float		speed_ratio = 0.0f;			// max |v|/r (VELOCITY_SCALE included) of the last frame
+	uint64_t	frames = 0;					// adaptive frames and their substeps, for the mean
+	uint64_t	total_substeps = 0;
+	int			peak_substeps = 0;
+
+	// public functions
+	void	advance( float frame_dt, physics_t& physics, body_store_t& bodies, const std::vector<wall_t>& walls );
+	int		plan_substeps( float frame_dt, const body_store_t& bodies, bool b_parallel, float& h );	// adaptive: substep count and length h
+	void	reset_stats() { frames = total_substeps = 0; peak_substeps = 0; }
+};
+
+inline void fixed_stepper_t::advance(float frame_dt, physics_t& physics, body_store_t& bodies, const std::vector<wall_t>& walls)
+{
+	if (b_adaptive)
+	{
+		float h;
+		substeps = plan_substeps(frame_dt, bodies, physics.b_parallel, h);
+		for (int k = 0; k < substeps; k++) physics.step(h, bodies, walls);
+		time += double(h) * substeps;
+		return;
+	}
+
+	accumulator += std::max(frame_dt, 0.0f);
+	for (substeps = 0; accumulator >= step && substeps < max_substeps; substeps++)
+	{
+		physics.step(step, bodies, walls);
+		accumulator -= step;
+		time += step;
+	}
+
+	// keep at most max_substeps of backlog for the next frames to catch up
+	double cap = double(max_substeps) * step;
+	if (accumulator > cap)
+	{
+		dropped_time += accumulator - cap;
+		accumulator = cap;
+	}
+}
+
+inline int fixed_stepper_t::plan_substeps(float frame_dt, const body_store_t& bodies, bool b_parallel, float& h)
+{
+	h = 0.0f;
+	if (frame_dt <= 0.0f) return 0;
+	float frame = std::min(frame_dt, MAX_DT);
+	dropped_time += frame_dt - frame;
+
+	// max is order-independent, so the count does not depend on the thread split
+	std::atomic<float> peak(0.0f);
+	auto reduce = [&](size_t begin, size_t end)
+	{
+		float m = max_speed_ratio(bodies, begin, end), p = peak;
+		while (m > p && !peak.compare_exchange_weak(p, m));
+	};
+	if (b_parallel) parallel_for(bodies.size(), BODY_GRAIN, reduce);
+	else reduce(0, bodies.size());
+	speed_ratio = peak * VELOCITY_SCALE;
+
+	float need = speed_ratio * frame / cfl;
+	int n = need > 1.0f ? int(std::ceil(need)) : 1;
+	if (n > max_substeps)
+	{
+		n = max_substeps;
+		h = cfl / speed_ratio;
+		dropped_time += frame - double(h) * n;
+	}
+	else h = frame / float(n);
+
+	frames++;
+	total_substeps += uint64_t(n);
+	peak_substeps = std::max(peak_substeps, n);
+	return n;
+}
+
+#endif
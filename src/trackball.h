@@ -161,4 +161,14 @@ inline vec2 cursor_to_ndc(dvec2 cursor, ivec2 window_size)
 	return vec2(npos.x * 2.0f - 1.0f, 1.0f - npos.y * 2.0f);
 }
 
+// world-space direction of the ray from the eye through a point in [-1,1]^2
+inline vec3 pick_ray(const camera& cam, vec2 npos)
+{
+	vec3 n = (cam.at - cam.eye).normalize();
+	vec3 u = n.cross(cam.up).normalize();
+	vec3 v = u.cross(n);
+	float h = tanf(cam.fovy * 0.5f);
+	return (n + u * (npos.x * h * cam.aspect) + v * (npos.y * h)).normalize();
+}
+
 #endif // __TRACKBALL_H__
@@ -0,0 +1,436 @@
+#pragma once
+#ifndef __TRAJECTORY_H__
+#define __TRAJECTORY_H__
+
+#include <condition_variable>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+* Compressed trajectory of the body centers, one frame per physics step
+* - centers are quantized to integers of quantum (TRAJ_QUANTUM) relative to the box corner lo,
+*   so the error is quantum/2 (plus float rounding) on every axis
+* - frames are grouped in chunks of keyframe_interval frames; the first frame of a chunk is a
+*   keyframe (absolute values), the second is the difference to it, and the others are the
+*   residual to the linear prediction 2 q[t-1] - q[t-2]: a free-flying body leaves only the
+*   rounding (-1, 0, 1), so a body costs one byte per frame unless it collided
+* - residual triplet: one byte (rx+2)*25 + (ry+2)*5 + (rz+2) when all |r| <= 2, otherwise
+*   TRAJ_ESCAPE and three zigzag varints
+* - radius (float) and tex_idx are stored once after the header (the body set is fixed while
+*   recording)
+* - the chunk offsets are written as an index at the end, so frame f is found in O(1) at
+*   chunk f / keyframe_interval and decoded from its keyframe; a file that was not closed is
+*   indexed by walking the chunk headers
+* - trajectory_writer_t copies the centers on the stepping thread and encodes and writes them on
+*   its own thread; at most TRAJ_MAX_PENDING frames wait, beyond that push() waits so that no
+*   frame is dropped
+*/
+static const char		TRAJ_MAGIC[8] = { 'C', 'G', 'T', 'R', 'A', 'J', '\r', '\n' };
+static const uint32_t	TRAJ_VERSION = 1;
+static const uint32_t	TRAJ_CHUNK_MAGIC = 0x4B4E4843;	// "CHNK"
+static const float		TRAJ_QUANTUM = 1.0f / 32.0f;	// position step; error <= TRAJ_QUANTUM / 2
+static const uint32_t	TRAJ_KEYFRAME_INTERVAL = 32;	// frames per chunk
+static const size_t		TRAJ_MAX_PENDING = 8;			// frames queued for the encoder
+static const uint8_t	TRAJ_ESCAPE = 0xFF;
+
+// 64-bit offsets; long runs of many bodies pass 2 GB
+inline int seek64(FILE* fp, uint64_t offset)
+{
+#ifdef _WIN32
+	return _fseeki64(fp, int64_t(offset), SEEK_SET);
+#else
+	return fseeko(fp, off_t(offset), SEEK_SET);
+#endif
+}
+
+struct trajectory_header_t
+{
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	header_size;		// sizeof(trajectory_header_t)
+	uint64_t	body_count;
+	uint64_t	frame_count;		// written by close()
+	uint64_t	index_offset;		// chunk offsets (uint64 per chunk); 0: not closed
+	uint32_t	keyframe_interval;
+	float		quantum;
+	float		frame_dt;			// simulated time between frames
+	float		lo[3];				// quantization origin
+	double		start_time;			// simulated time of frame 0
+	float		hi[3];				// box interior corner opposite lo; hi <= lo: unknown
+	uint32_t	reserved;
+};
+
+struct trajectory_chunk_t
+{
+	uint32_t	magic;
+	uint32_t	frame_count;
+	uint64_t	first_frame;
+	uint64_t	bytes;				// payload after this header
+};
+
+inline uint32_t zigzag(int32_t v) { return (uint32_t(v) << 1) ^ uint32_t(v >> 31); }
+inline int32_t unzigzag(uint32_t u) { return int32_t(u >> 1) ^ -int32_t(u & 1); }
+
+inline void put_varint(std::vector<uint8_t>& out, uint32_t v)
+{
+	for (; v >= 0x80; v >>= 7) out.push_back(uint8_t(v | 0x80));
+	out.push_back(uint8_t(v));
+}
+
+inline uint32_t get_varint(const uint8_t*& p, const uint8_t* end)
+{
+	uint32_t v = 0;
+	for (int shift = 0; p < end && shift < 35; shift += 7)
+	{
+		uint8_t b = *p++;
+		v |= uint32_t(b & 0x7F) << shift;
+		if (!(b & 0x80)) break;
+	}
+	return v;
+}
+
+// residuals of one body; q, p1, p2: current, previous and the one before, k: frame in the chunk
+inline void put_residual(std::vector<uint8_t>& out, const int32_t* q, const int32_t* p1, const int32_t* p2, uint32_t k)
+{
+	int32_t r[3];
+	for (int a = 0; a < 3; a++) r[a] = k == 0 ? q[a] : k == 1 ? q[a] - p1[a] : q[a] - (2 * p1[a] - p2[a]);
+	if (k && abs(r[0]) <= 2 && abs(r[1]) <= 2 && abs(r[2]) <= 2) { out.push_back(uint8_t((r[0] + 2) * 25 + (r[1] + 2) * 5 + (r[2] + 2))); return; }
+	out.push_back(TRAJ_ESCAPE);
+	for (int a = 0; a < 3; a++) put_varint(out, zigzag(r[a]));
+}
+
+inline void get_residual(const uint8_t*& p, const uint8_t* end, int32_t* q, const int32_t* p1, const int32_t* p2, uint32_t k)
+{
+	int32_t r[3];
+	uint8_t code = p < end ? *p++ : TRAJ_ESCAPE;
+	if (code != TRAJ_ESCAPE) { r[0] = code / 25 - 2; r[1] = code / 5 % 5 - 2; r[2] = code % 5 - 2; }
+	else for (int a = 0; a < 3; a++) r[a] = unzigzag(get_varint(p, end));
+	for (int a = 0; a < 3; a++) q[a] = k == 0 ? r[a] : k == 1 ? p1[a] + r[a] : 2 * p1[a] - p2[a] + r[a];
+}
+
+//*************************************
+struct trajectory_writer_t
+{
+	FILE*					fp = nullptr;
+	trajectory_header_t		header;
+	std::vector<uint64_t>	index;			// chunk offsets
+	uint64_t				bytes = 0;		// written so far
+	bool					failed = false;
+
+	// encoder thread
+	std::vector<int32_t>	q, p1, p2;		// current, previous, the one before (xyz per body)
+	std::vector<uint8_t>	chunk;
+	uint32_t				chunk_frames = 0;
+	uint64_t				encoded = 0;	// frames encoded
+
+	// frames waiting for the encoder (xyz per body)
+	std::mutex				mutex;
+	std::condition_variable	cv;
+	std::deque<std::vector<float>>	queue;
+	std::vector<std::vector<float>>	pool;	// recycled frame buffers
+	bool					b_stop = false;
+	std::thread				worker;
+
+	trajectory_writer_t() = default;
+	trajectory_writer_t( const trajectory_writer_t& ) = delete;
+	trajectory_writer_t& operator=( const trajectory_writer_t& ) = delete;
+	~trajectory_writer_t() { close(); }
+
+	// public functions
+	bool	open( const char* path, const body_store_t& bodies, vec3 lo, vec3 hi, float frame_dt, double start_time = 0.0, float quantum = TRAJ_QUANTUM, uint32_t keyframe_interval = TRAJ_KEYFRAME_INTERVAL );
+	void	push( const body_store_t& bodies );	// one frame; waits when the encoder is TRAJ_MAX_PENDING frames behind
+	void	close();
+	bool	is_open() const { return fp != nullptr; }
+	uint64_t	frame_count() const { return header.frame_count; }
+
+	// internal functions
+	void	run();
+	void	encode( const std::vector<float>& frame );
+	void	flush_chunk();
+	void	write( const void* data, size_t size );
+};
+
+inline void trajectory_writer_t::write(const void* data, size_t size)
+{
+	if (fwrite(data, 1, size, fp) != size) failed = true;
+	bytes += size;
+}
+
+inline bool trajectory_writer_t::open(const char* path, const body_store_t& b, vec3 lo, vec3 hi, float frame_dt, double start_time, float quantum, uint32_t keyframe_interval)
+{
+	close();
+	if (!(fp = fopen(path, "wb"))) { printf("Failed to open %s\n", path); return false; }
+
+	size_t n = b.size();
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, TRAJ_MAGIC, sizeof(header.magic));
+	header.version = TRAJ_VERSION;
+	header.header_size = uint32_t(sizeof(header));
+	header.body_count = n;
+	header.keyframe_interval = std::max(keyframe_interval, 2u);
+	header.quantum = quantum;
+	header.frame_dt = frame_dt;
+	header.lo[0] = lo.x; header.lo[1] = lo.y; header.lo[2] = lo.z;
+	header.hi[0] = hi.x; header.hi[1] = hi.y; header.hi[2] = hi.z;
+	header.start_time = start_time;
+
+	bytes = 0;
+	failed = false;
+	write(&header, sizeof(header));
+	float_array radius(n);	// float in the file whatever real is, as the quantized centers
+	std::vector<int32_t> tex(n);
+	for (size_t i = 0; i < n; i++) { radius[i] = float(b.radius[i]); tex[i] = b.render[i].tex_idx; }
+	write(radius.data(), n * sizeof(float));
+	write(tex.data(), n * sizeof(int32_t));
+
+	index.clear();
+	q.assign(3 * n, 0); p1.assign(3 * n, 0); p2.assign(3 * n, 0);
+	chunk.clear();
+	chunk_frames = 0;
+	encoded = 0;
+	b_stop = false;
+	worker = std::thread([this]() { run(); });
+	return true;
+}
+
+inline void trajectory_writer_t::push(const body_store_t& b)
+{
+	if (!fp || b.size() != header.body_count) return;
+
+	std::vector<float> frame;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		cv.wait(lock, [&]() { return queue.size() < TRAJ_MAX_PENDING; });
+		if (!pool.empty()) { frame.swap(pool.back()); pool.pop_back(); }
+	}
+	size_t n = b.size();
+	frame.resize(3 * n);
+	for (size_t i = 0; i < n; i++) { frame[3 * i] = float(b.px[i]); frame[3 * i + 1] = float(b.py[i]); frame[3 * i + 2] = float(b.pz[i]); }
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(std::move(frame));
+		header.frame_count++;
+	}
+	cv.notify_all();
+}
+
+inline void trajectory_writer_t::run()
+{
+	for (;;)
+	{
+		std::vector<float> frame;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cv.wait(lock, [&]() { return b_stop || !queue.empty(); });
+			if (queue.empty()) return;
+			frame.swap(queue.front());
+			queue.pop_front();
+		}
+		cv.notify_all();
+		encode(frame);
+		std::lock_guard<std::mutex> lock(mutex);
+		pool.push_back(std::move(frame));
+	}
+}
+
+inline void trajectory_writer_t::encode(const std::vector<float>& frame)
+{
+	size_t n = header.body_count;
+	float inv = 1.0f / header.quantum;
+	for (size_t i = 0; i < n; i++)
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			float v = (frame[3 * i + a] - header.lo[a]) * inv;
+			q[3 * i + a] = int32_t(lrintf(std::min(std::max(v, -1e9f), 1e9f)));
+		}
+		put_residual(chunk, &q[3 * i], &p1[3 * i], &p2[3 * i], chunk_frames);
+	}
+	p2.swap(p1);
+	p1.swap(q);
+	encoded++;
+	if (++chunk_frames == header.keyframe_interval) flush_chunk();
+}
+
+inline void trajectory_writer_t::flush_chunk()
+{
+	if (!chunk_frames) return;
+	trajectory_chunk_t c = { TRAJ_CHUNK_MAGIC, chunk_frames, encoded - chunk_frames, chunk.size() };
+	index.push_back(bytes);
+	write(&c, sizeof(c));
+	write(chunk.data(), chunk.size());
+	chunk.clear();
+	chunk_frames = 0;
+}
+
+inline void trajectory_writer_t::close()
+{
+	if (!fp) return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		b_stop = true;
+	}
+	cv.notify_all();
+	if (worker.joinable()) worker.join();
+	flush_chunk();
+
+	header.index_offset = bytes;
+	write(index.data(), index.size() * sizeof(uint64_t));
+	fseek(fp, 0, SEEK_SET);
+	if (fwrite(&header, sizeof(header), 1, fp) != 1) failed = true;
+	if (fclose(fp) != 0) failed = true;
+	fp = nullptr;
+	if (failed) printf("Failed to write the trajectory\n");
+	queue.clear();
+	pool.clear();
+}
+
+//*************************************
+struct trajectory_reader_t
+{
+	FILE*					fp = nullptr;
+	trajectory_header_t		header;
+	float_array				radius;
+	std::vector<int32_t>	tex_idx;
+	std::vector<uint64_t>	index;			// chunk offsets
+	uint64_t				frames = 0;
+
+	// decoder state: frame decoded of chunk
+	int64_t					chunk_id = -1;
+	std::vector<uint8_t>	chunk;
+	const uint8_t*			cursor = nullptr;
+	int64_t					decoded = -1;	// frame in the chunk held by q
+	std::vector<int32_t>	q, p1, p2;
+
+	trajectory_reader_t() = default;
+	trajectory_reader_t( const trajectory_reader_t& ) = delete;
+	trajectory_reader_t& operator=( const trajectory_reader_t& ) = delete;
+	~trajectory_reader_t() { close(); }
+
+	// public functions
+	bool	open( const char* path );
+	void	close() { if (fp) fclose(fp); fp = nullptr; }
+	uint64_t	frame_count() const { return frames; }
+	size_t	body_count() const { return size_t(header.body_count); }
+	double	frame_time( uint64_t f ) const { return header.start_time + double(f) * header.frame_dt; }
+	template <typename Real>
+	bool	read_frame( uint64_t f, Real* px, Real* py, Real* pz );	// O(keyframe_interval) at most
+	bool	read_frame( uint64_t f, body_store_t& bodies );
+	void	init_bodies( body_store_t& bodies ) const;	// radius and tex_idx, no velocity
+
+	// internal functions
+	bool	load_chunk( int64_t c );
+	void	build_index();
+};
+
+inline bool trajectory_reader_t::open(const char* path)
+{
+	close();
+	if (!(fp = fopen(path, "rb"))) { printf("Failed to open %s\n", path); return false; }
+	if (fread(&header, sizeof(header), 1, fp) != 1 || memcmp(header.magic, TRAJ_MAGIC, sizeof(header.magic)) != 0
+		|| header.version != TRAJ_VERSION || header.header_size != sizeof(header) || header.keyframe_interval < 2)
+	{
+		close();
+		printf("%s is not a version %u trajectory\n", path, TRAJ_VERSION);
+		return false;
+	}
+
+	size_t n = body_count();
+	radius.resize(n);
+	tex_idx.resize(n);
+	if (fread(radius.data(), sizeof(float), n, fp) != n || fread(tex_idx.data(), sizeof(int32_t), n, fp) != n) { close(); printf("%s is truncated\n", path); return false; }
+
+	index.clear();
+	frames = header.frame_count;
+	uint64_t chunks = (frames + header.keyframe_interval - 1) / header.keyframe_interval;
+	index.resize(size_t(chunks));
+	if (!header.index_offset || seek64(fp, header.index_offset) != 0 || fread(index.data(), sizeof(uint64_t), index.size(), fp) != index.size()) build_index();
+
+	q.assign(3 * n, 0); p1.assign(3 * n, 0); p2.assign(3 * n, 0);
+	chunk_id = -1;
+	decoded = -1;
+	return true;
+}
+
+// walks the chunk headers of a file that was not closed; a truncated last chunk is dropped
+inline void trajectory_reader_t::build_index()
+{
+	index.clear();
+	frames = 0;
+	uint64_t at = sizeof(header) + body_count() * (sizeof(float) + sizeof(int32_t));
+	trajectory_chunk_t c;
+	while (seek64(fp, at) == 0 && fread(&c, sizeof(c), 1, fp) == 1 && c.magic == TRAJ_CHUNK_MAGIC && c.first_frame == frames)
+	{
+		if (seek64(fp, at + sizeof(c) + c.bytes - 1) != 0 || fgetc(fp) == EOF) break;
+		index.push_back(at);
+		frames += c.frame_count;
+		at += sizeof(c) + c.bytes;
+		if (c.frame_count < header.keyframe_interval) break;	// the last chunk
+	}
+}
+
+inline bool trajectory_reader_t::load_chunk(int64_t c)
+{
+	trajectory_chunk_t h;
+	if (seek64(fp, index[size_t(c)]) != 0 || fread(&h, sizeof(h), 1, fp) != 1 || h.magic != TRAJ_CHUNK_MAGIC) return false;
+	chunk.resize(size_t(h.bytes));
+	if (fread(chunk.data(), 1, chunk.size(), fp) != chunk.size()) return false;
+	chunk_id = c;
+	cursor = chunk.data();
+	decoded = -1;
+	return true;
+}
+
+template <typename Real>
+inline bool trajectory_reader_t::read_frame(uint64_t f, Real* px, Real* py, Real* pz)
+{
+	if (!fp || f >= frames) return false;
+	int64_t c = int64_t(f / header.keyframe_interval), k = int64_t(f % header.keyframe_interval);
+	if ((c != chunk_id || k < decoded) && !load_chunk(c)) { chunk_id = -1; return false; }
+
+	size_t n = body_count();
+	const uint8_t* end = chunk.data() + chunk.size();
+	while (decoded < k)
+	{
+		decoded++;
+		p2.swap(p1);
+		p1.swap(q);
+		for (size_t i = 0; i < n; i++) get_residual(cursor, end, &q[3 * i], &p1[3 * i], &p2[3 * i], uint32_t(decoded));
+	}
+
+	float s = header.quantum;
+	for (size_t i = 0; i < n; i++)
+	{
+		px[i] = Real(header.lo[0] + float(q[3 * i]) * s);
+		py[i] = Real(header.lo[1] + float(q[3 * i + 1]) * s);
+		pz[i] = Real(header.lo[2] + float(q[3 * i + 2]) * s);
+	}
+	return true;
+}
+
+inline bool trajectory_reader_t::read_frame(uint64_t f, body_store_t& b)
+{
+	if (b.size() != body_count()) init_bodies(b);
+	return read_frame(f, b.px.data(), b.py.data(), b.pz.data());
+}
+
+inline void trajectory_reader_t::init_bodies(body_store_t& b) const
+{
+	b.clear();
+	b.reserve(body_count());
+	for (size_t i = 0; i < body_count(); i++)
+	{
+		sphere_t s;
+		s.radius = radius[i];
+		s.tex_idx = tex_idx[i];
+		b.add(s);
+	}
+}
+
+#endif
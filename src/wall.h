@@ -2,19 +2,25 @@
 #ifndef __WALL_H__
 #define __WALL_H__
 
+#include <vector>
+
+/*
+* Container walls
+* - geometry only, no OpenGL: the physics and the headless build use the planes,
+*   the renderer creates its own buffers from vertices and indices
+* - the order floor, ceil, back, left, right, front (0~5) is assumed by the spawner
+*   and the event-driven engine
+*/
+
 const vec4 GRAY = { 0.725f, 0.710f, 0.680f, 1.0f };
 const vec4 RED = { 0.630f, 0.065f, 0.050f, 1.0f };
 const vec4 GREEN = { 0.137f, 0.447f, 0.090f, 1.0f };
 
 struct wall_t
 {
-	// geometry information
-	std::vector<vertex> vertices;
-	std::vector<uint> indices;
-	// gpu
-	GLuint				vertex_array = 0;
-	GLuint				vertex_buffer = 0;
-	GLuint				index_buffer = 0;
+	// geometry information; the normal of every vertex is the plane normal
+	std::vector<vec3>	vertices;
+	std::vector<uint>	indices;
 
 	vec4				color;
 	mat4				model_matrix =
@@ -29,31 +35,6 @@ struct wall_t
 	float				dist;   // distance from O to plane
 };
 
-inline void set_wall_vao(wall_t& wall)
-{
-	// clear and create new buffers
-	if (wall.vertex_buffer) { glDeleteBuffers(1, &wall.vertex_buffer);	wall.vertex_buffer = 0; }
-	if (wall.index_buffer) { glDeleteBuffers(1, &wall.index_buffer);	wall.index_buffer = 0; }
-
-	// check exceptions
-	if (wall.vertices.empty()) { printf("[error] vertices is empty.\n"); return; }
-
-	// generation of vertex buffer: use vertices as it is
-	glGenBuffers(1, &wall.vertex_buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, wall.vertex_buffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertex) * wall.vertices.size(), &wall.vertices[0], GL_STATIC_DRAW);
-
-	// geneation of index buffer
-	glGenBuffers(1, &wall.index_buffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, wall.index_buffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint) * wall.indices.size(), &wall.indices[0], GL_STATIC_DRAW);
-
-	// generate vertex array object, which is mandatory for OpenGL 3.3 and higher
-	if (wall.vertex_array) glDeleteVertexArrays(1, &wall.vertex_array);
-	wall.vertex_array = cg_create_vertex_array(wall.vertex_buffer, wall.index_buffer);
-	if (!wall.vertex_array) { printf("%s(): failed to create vertex aray\n", __func__); return; }
-}
-
 inline std::vector<wall_t> create_cornellbox()
 {
 	std::vector<wall_t> walls;
@@ -67,16 +48,14 @@ inline std::vector<wall_t> create_cornellbox()
 		wall.color = GRAY;
 		wall.vertices =
 		{
-			{ vec3(552.8f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f) },
-			{ vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f) },
-			{ vec3(0.0f, 0.0f, -559.2f), vec3(0.0f, 1.0f, 0.0f) },
-			{ vec3(549.6f, 0.0f, -559.2f), vec3(0.0f, 1.0f, 0.0f) }
+			vec3(552.8f, 0.0f, 0.0f),
+			vec3(0.0f, 0.0f, 0.0f),
+			vec3(0.0f, 0.0f, -559.2f),
+			vec3(549.6f, 0.0f, -559.2f)
 		};
 		wall.indices = { 1,0,3,3,2,1 };
 		wall.normal = vec3(0.0f, 1.0f, 0.0f);
 		wall.dist = 0.0f;
-		
-		set_wall_vao(wall);
 
 		walls.push_back(wall);
 	}
@@ -90,17 +69,15 @@ inline std::vector<wall_t> create_cornellbox()
 		wall.color = GRAY;
 		wall.vertices =
 		{
-			{vec3(556.0f, 548.8f, 0.0f), vec3(0.0f, -1.0f, 0.0f)},
-			{vec3(556.0f, 548.8f, -559.2f), vec3(0.0f, -1.0f, 0.0f)},
-			{vec3(0.0f, 548.8f, -559.2f), vec3(0.0f, -1.0f, 0.0f)},
-			{vec3(0.0f, 548.8f, 0.0f), vec3(0.0f, -1.0f, 0.0f)}
+			vec3(556.0f, 548.8f, 0.0f),
+			vec3(556.0f, 548.8f, -559.2f),
+			vec3(0.0f, 548.8f, -559.2f),
+			vec3(0.0f, 548.8f, 0.0f)
 		};
 		wall.indices = { 3,2,1,1,0,3 };
 		wall.normal = vec3(0.0f, -1.0f, 0.0f);
 		wall.dist = -548.8f;
 
-		set_wall_vao(wall);
-
 		walls.push_back(wall);
 	}
 
@@ -113,17 +90,15 @@ inline std::vector<wall_t> create_cornellbox()
 		wall.color = GRAY;
 		wall.vertices =
 		{
-			{vec3(549.6f, 0.0f, -559.2f), vec3(0.0f, 0.0f, 1.0f)},
-			{vec3(0.0f, 0.0f, -559.2f), vec3(0.0f, 0.0f, 1.0f)},
-			{vec3(0.0f, 548.8f, -559.2f), vec3(0.0f, 0.0f, 1.0f)},
-			{vec3(556.0f, 548.8f, -559.2f), vec3(0.0f, 0.0f, 1.0f)}
+			vec3(549.6f, 0.0f, -559.2f),
+			vec3(0.0f, 0.0f, -559.2f),
+			vec3(0.0f, 548.8f, -559.2f),
+			vec3(556.0f, 548.8f, -559.2f)
 		};
 		wall.indices = { 1,0,3,3,2,1 };
 		wall.normal = vec3(0.0f, 0.0f, 1.0f);
 		wall.dist = -559.2f;
 
-		set_wall_vao(wall);
-
 		walls.push_back(wall);
 	}
 
@@ -136,17 +111,15 @@ inline std::vector<wall_t> create_cornellbox()
 		wall.color = RED;
 		wall.vertices =
 		{
-			{vec3(0.0f, 0.0f, -559.2f), vec3(1.0f, 0.0f, 0.0f)},
-			{vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f)},
-			{vec3(0.0f, 548.8f, 0.0f), vec3(1.0f, 0.0f, 0.0f)},
-			{vec3(0.0f, 548.8f, -559.2f), vec3(1.0f, 0.0f, 0.0f)}
+			vec3(0.0f, 0.0f, -559.2f),
+			vec3(0.0f, 0.0f, 0.0f),
+			vec3(0.0f, 548.8f, 0.0f),
+			vec3(0.0f, 548.8f, -559.2f)
 		};
 		wall.indices = { 1,0,3,3,2,1 };
 		wall.normal = vec3(1.0f, 0.0f, 0.0f);
 		wall.dist = 0.0f;
 
-		set_wall_vao(wall);
-
 		walls.push_back(wall);
 	}
 
@@ -159,17 +132,15 @@ inline std::vector<wall_t> create_cornellbox()
 		wall.color = GREEN;
 		wall.vertices =
 		{
-			{vec3(552.8f, 0.0f, 0.0f), vec3(-1.0f, 0.0f, 0.0f)},
-			{vec3(549.6f, 0.0f, -559.2f), vec3(-1.0f, 0.0f, 0.0f)},
-			{vec3(556.0f, 548.8f, -559.2f), vec3(-1.0f, 0.0f, 0.0f)},
-			{vec3(556.0f, 548.8f, 0.0f), vec3(-1.0f, 0.0f, 0.0f)}
+			vec3(552.8f, 0.0f, 0.0f),
+			vec3(549.6f, 0.0f, -559.2f),
+			vec3(556.0f, 548.8f, -559.2f),
+			vec3(556.0f, 548.8f, 0.0f)
 		};
 		wall.indices = { 3,2,1,1,0,3 };
 		wall.normal = vec3(-1.0f, 0.0f, 0.0f);
 		wall.dist = -556.0f;
 
-		set_wall_vao(wall);
-
 		walls.push_back(wall);
 	}
 
@@ -182,21 +153,59 @@ inline std::vector<wall_t> create_cornellbox()
 		wall.color = GRAY;
 		wall.vertices =
 		{
-			{vec3(0.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, -1.0f)},
-			{vec3(552.8f, 0.0f, 0.0f), vec3(0.0f, 0.0f, -1.0f)},
-			{vec3(556.0f, 548.8f, 0.0f), vec3(0.0f, 0.0f, -1.0f)},
-			{vec3(0.0f, 548.8f, 0.0f), vec3(0.0f, 0.0f, -1.0f)}
+			vec3(0.0f, 0.0f, 0.0f),
+			vec3(552.8f, 0.0f, 0.0f),
+			vec3(556.0f, 548.8f, 0.0f),
+			vec3(0.0f, 548.8f, 0.0f)
 		};
 		wall.indices = { 3,2,1,1,0,3 };
 		wall.normal = vec3(0.0f, 0.0f, -1.0f);
 		wall.dist = 0.0f;
 
-		set_wall_vao(wall);
-
 		walls.push_back(wall);
 	}
 	
 	return walls;
 }
 
-#endif
\ No newline at end of file
+// interior [lo, hi] of a box whose walls are in the order of create_cornellbox()
+inline void box_interior(const std::vector<wall_t>& walls, vec3& lo, vec3& hi)
+{
+	lo = vec3(walls[3].dist, walls[0].dist, walls[2].dist);
+	hi = vec3(-walls[4].dist, -walls[1].dist, -walls[5].dist);
+}
+
+// axis-aligned box [0,size.x] x [0,size.y] x [-size.z,0], walls in the order of create_cornellbox()
+inline std::vector<wall_t> create_box(vec3 size)
+{
+	vec3 lo = vec3(0.0f, 0.0f, -size.z), hi = vec3(size.x, size.y, 0.0f);
+	struct { int axis; float sign; vec4 color; } faces[6] =
+		{ { 1, 1.0f, GRAY }, { 1, -1.0f, GRAY }, { 2, 1.0f, GRAY }, { 0, 1.0f, RED }, { 0, -1.0f, GREEN }, { 2, -1.0f, GRAY } };
+
+	std::vector<wall_t> walls;
+	for (auto& f : faces)
+	{
+		int a = f.axis, u = (a + 1) % 3, v = (a + 2) % 3;
+		float p = f.sign > 0 ? (&lo.x)[a] : (&hi.x)[a];
+
+		wall_t wall;
+		wall.color = f.color;
+		wall.normal = vec3(0.0f);
+		(&wall.normal.x)[a] = f.sign;
+		wall.dist = f.sign * p;
+		for (int c = 0; c < 4; c++)
+		{
+			vec3 corner;
+			(&corner.x)[a] = p;
+			(&corner.x)[u] = (c == 1 || c == 2) ? (&hi.x)[u] : (&lo.x)[u];
+			(&corner.x)[v] = (c >= 2) ? (&hi.x)[v] : (&lo.x)[v];
+			wall.vertices.push_back(corner);
+		}
+		// counter-clockwise seen from inside: cross(u, v) is +axis
+		wall.indices = f.sign > 0 ? std::vector<uint>{ 0,1,2,2,3,0 } : std::vector<uint>{ 0,3,2,2,1,0 };
+		walls.push_back(wall);
+	}
+	return walls;
+}
+
+#endif